@@ -0,0 +1,66 @@
+// Copyright 2014 Adam Wulkiewicz.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef ATOMIC_FILE_HPP
+#define ATOMIC_FILE_HPP
+
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+// Files are written to temporary files first and then replace the destination
+// files, so readers never see partially written files. Files with unchanged
+// content aren't replaced.
+
+inline std::string temporary_path(std::string const& filename)
+{
+    return filename + ".tmp";
+}
+
+inline bool read_file(std::string const& filename, std::string & content)
+{
+    std::ifstream ifs(filename.c_str(), std::ios::binary);
+    if ( !ifs.is_open() )
+        return false;
+    content.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// Atomically replaces the file with the temporary file
+inline void replace_file(std::string const& filename)
+{
+    boost::filesystem::rename(temporary_path(filename), filename);
+}
+
+// Replaces the file with the temporary file if their contents are different,
+// otherwise removes the temporary file. Returns true if the file was replaced.
+inline bool replace_file_if_changed(std::string const& filename)
+{
+    std::string temp_filename = temporary_path(filename);
+
+    boost::system::error_code ec;
+    boost::uintmax_t size = boost::filesystem::file_size(filename, ec);
+    if ( !ec && size == boost::filesystem::file_size(temp_filename) )
+    {
+        std::string old_content, new_content;
+        if ( read_file(filename, old_content)
+          && read_file(temp_filename, new_content)
+          && old_content == new_content )
+        {
+            boost::filesystem::remove(temp_filename);
+            return false;
+        }
+    }
+
+    replace_file(filename);
+    return true;
+}
+
+#endif // ATOMIC_FILE_HPP
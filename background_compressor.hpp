@@ -0,0 +1,150 @@
+// Copyright 2014 Adam Wulkiewicz.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef BACKGROUND_COMPRESSOR_HPP
+#define BACKGROUND_COMPRESSOR_HPP
+
+
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "atomic_file.hpp"
+
+// Writes gzip compressed copies of files (file.gz) in a background thread
+// so files can be compressed while the next ones are being produced.
+// If disabled nothing is done.
+class background_compressor
+    : boost::noncopyable
+{
+public:
+    explicit background_compressor(bool enabled)
+        : stopped(false)
+    {
+        if ( enabled )
+            thread.reset(new boost::thread(boost::bind(&background_compressor::worker, this)));
+    }
+
+    ~background_compressor()
+    {
+        finish();
+    }
+
+    // The file must not be modified until it's compressed
+    void add(std::string const& filename)
+    {
+        if ( !thread )
+            return;
+
+        {
+            boost::lock_guard<boost::mutex> lock(mutex);
+            files.push_back(filename);
+        }
+        condition.notify_one();
+    }
+
+    // Waits until all files are compressed
+    void finish()
+    {
+        if ( !thread )
+            return;
+
+        {
+            boost::lock_guard<boost::mutex> lock(mutex);
+            stopped = true;
+        }
+        condition.notify_one();
+        thread->join();
+        thread.reset();
+    }
+
+    // True if the compressed copy is missing or older than the file, e.g. if the
+    // file was changed without compression or the process was stopped
+    // before the file was compressed
+    static bool is_outdated(std::string const& filename)
+    {
+        boost::system::error_code ec;
+        std::time_t gz_time = boost::filesystem::last_write_time(filename + ".gz", ec);
+        if ( ec )
+            return true;
+        std::time_t time = boost::filesystem::last_write_time(filename, ec);
+        return ec || gz_time < time;
+    }
+
+    static void compress(std::string const& filename)
+    {
+        std::ifstream ifs(filename.c_str(), std::ios::binary);
+        if ( !ifs.is_open() )
+            throw std::runtime_error("unable to open file " + filename);
+
+        std::string gz_filename = filename + ".gz";
+        {
+            std::ofstream ofs(temporary_path(gz_filename).c_str(), std::ios::trunc | std::ios::binary);
+            if ( !ofs.is_open() )
+                throw std::runtime_error("unable to open file " + gz_filename);
+
+            // files are compressed once and served many times
+            boost::iostreams::filtering_ostream out;
+            out.push(boost::iostreams::gzip_compressor(boost::iostreams::gzip::best_compression));
+            out.push(ofs);
+            boost::iostreams::copy(ifs, out);
+
+            ofs.flush();
+            if ( !ofs )
+                throw std::runtime_error("unable to write file " + gz_filename);
+        }
+
+        replace_file(gz_filename);
+    }
+
+private:
+    void worker()
+    {
+        for (;;)
+        {
+            std::string filename;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while ( files.empty() && !stopped )
+                    condition.wait(lock);
+                if ( files.empty() )
+                    return;
+                filename = files.front();
+                files.pop_front();
+            }
+
+            try
+            {
+                compress(filename);
+            }
+            catch (std::exception & e)
+            {
+                std::cerr << "Error compressing " << filename << ": " << e.what() << std::endl;
+            }
+        }
+    }
+
+    boost::scoped_ptr<boost::thread> thread;
+    boost::mutex mutex;
+    boost::condition_variable condition;
+    std::deque<std::string> files;
+    bool stopped;
+};
+
+#endif // BACKGROUND_COMPRESSOR_HPP
@@ -0,0 +1,272 @@
+// Copyright 2014 Adam Wulkiewicz.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+// Measures the throughput of classification of logs, extraction of nested logs
+// and processing of summary pages.
+//
+// Usage: benchmark [pages_dir] [seconds]
+//
+// pages_dir - directory containing summary pages, by default example/pages
+// seconds - minimum time of each measurement, by default 0.5
+
+#include <chrono>
+#include <iomanip>
+
+#define SUMMARY_ENHANCER_NO_MAIN
+#include "../main.cpp"
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+// results are accumulated so the measured calls aren't optimized out
+std::size_t benchmark_sink = 0;
+
+double seconds_since(benchmark_clock::time_point const& start)
+{
+    return std::chrono::duration<double>(benchmark_clock::now() - start).count();
+}
+
+struct log_kind
+{
+    const char* name;
+    const char* marker; // in the status line, NULL if the log contains no known cause
+};
+
+// Representative logs, the marker is placed near the beginning like the status
+// of a test in the real logs and the rest is filled with compiler output
+const log_kind log_kinds[] = {
+    { "time", "Run [2015-04-01 10:00:00 UTC]: fail\n300 second time limit exceeded" },
+    { "ierr", "Compile [2015-04-01 10:00:00 UTC]: fail\ninternal compiler error: Segmentation fault" },
+    { "bigobj", "Compile [2015-04-01 10:00:00 UTC]: fail\nfatal error C1128: number of sections exceeded object file format limit: compile with /bigobj" },
+    { "comp", "Compile [2015-04-01 10:00:00 UTC]: fail" },
+    { "link", "Link [2015-04-01 10:00:00 UTC]: fail" },
+    { "run", "Run [2015-04-01 10:00:00 UTC]: fail" },
+    { "unkn", NULL }
+};
+
+std::string make_log(log_kind const& kind, std::size_t size)
+{
+    std::string log = "<html><head><title>Test output: geometry - algorithms_area / gcc-4.9</title></head><body>\n"
+                      "<div><h1>Test output: geometry - algorithms_area / gcc-4.9</h1>\n"
+                      "<div>Rev 1234 / Wed, 01 Apr 2015 10:00:00 +0000</div>\n<pre>\n";
+    if ( kind.marker )
+    {
+        log += kind.marker;
+        log += '\n';
+    }
+    else
+    {
+        // unknown failures contain links to the logs of the dependencies
+        log += "Lib [2015-04-01 10:00:00 UTC]: fail\nSee <a href=\"geometry-algorithms_area-gcc-4-9-variants_.html\">geometry-algorithms_area-gcc-4-9</a>\n";
+        log += "See <a href=\"geometry-test-geometries-gcc-4-9-variants_.html\">geometry-test-geometries-gcc-4-9</a>\n";
+    }
+
+    for ( std::size_t i = 0 ; log.size() < size ; ++i )
+    {
+        std::stringstream ss;
+        if ( i % 4 == 3 )
+            ss << "../../../boost/geometry/algorithms/detail/overlay/get_turns_" << i << ".hpp:" << i % 1000
+               << ":12: warning: unused variable 'turns' [-Wunused-variable]\n";
+        else
+            ss << "\"g++\" -ftemplate-depth-128 -O0 -fno-inline -Wall -g -fPIC -DBOOST_ALL_NO_LIB=1 -I\"../../..\" "
+               << "-c -o \"../../../bin.v2/libs/geometry/test/algorithms/area_" << i << ".o\" \"area.cpp\"\n";
+        log += ss.str();
+    }
+    log += "</pre>\n</div></body></html>\n";
+    return log;
+}
+
+void print_header()
+{
+    std::cout << std::left << std::setw(16) << "stage"
+              << std::setw(34) << "input"
+              << std::right << std::setw(12) << "MB/s"
+              << std::setw(16) << "ns/cell" << std::endl;
+}
+
+void print_result(std::string const& stage, std::string const& input,
+                  std::size_t bytes, std::size_t cells, std::size_t iterations, double seconds)
+{
+    double mbps = double(bytes) * iterations / seconds / (1024 * 1024);
+    double ns = seconds * 1e9 / (double(cells) * iterations);
+    std::cout << std::left << std::setw(16) << stage
+              << std::setw(34) << input
+              << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << mbps
+              << std::setw(16) << ns << std::endl;
+}
+
+// find_reason, one log per cell
+void benchmark_find_reason(std::string const& name, std::string const& log,
+                           options const& op, double min_seconds)
+{
+    std::size_t iterations = 0;
+    benchmark_clock::time_point start = benchmark_clock::now();
+    double seconds = 0;
+    do
+    {
+        benchmark_sink += find_reason(log, op).index();
+        ++iterations;
+        seconds = seconds_since(start);
+    } while ( seconds < min_seconds );
+
+    print_result("find_reason", name, log.size(), 1, iterations, seconds);
+
+    // the whole log, without scan windows
+    iterations = 0;
+    start = benchmark_clock::now();
+    do
+    {
+        benchmark_sink += classification_rules().find_reason(log).index();
+        ++iterations;
+        seconds = seconds_since(start);
+    } while ( seconds < min_seconds );
+
+    print_result("find_reason*", name, log.size(), 1, iterations, seconds);
+}
+
+// append_hrefs, one log per cell, the log is copied before each parsing
+// because it's parsed in situ and the copying isn't measured
+void benchmark_append_hrefs(std::string const& name, std::string const& log, double min_seconds)
+{
+    document_pool pool;
+    std::string copy;
+    std::vector<std::string> hrefs;
+
+    std::size_t iterations = 0;
+    double seconds = 0;
+    do
+    {
+        copy = log;
+        hrefs.clear();
+
+        benchmark_clock::time_point start = benchmark_clock::now();
+        append_hrefs(copy, hrefs, pool);
+        seconds += seconds_since(start);
+
+        benchmark_sink += hrefs.size();
+        ++iterations;
+    } while ( seconds < min_seconds );
+
+    print_result("append_hrefs", name, log.size(), 1, iterations, seconds);
+}
+
+// parsing, gather_nodes and printing to a temporary file, cells are all test
+// results of the page
+void benchmark_page(std::string const& name, std::string const& page,
+                    boost::filesystem::path const& temp_path,
+                    options const& op, double min_seconds)
+{
+    std::size_t cells = 0;
+    for ( std::string::size_type pos = page.find("<td class=\"library-") ;
+          pos != std::string::npos ;
+          pos = page.find("<td class=\"library-", pos + 1) )
+    {
+        ++cells;
+    }
+    if ( cells == 0 )
+        cells = 1;
+
+    document_pool pool;
+    std::string copy;
+
+    std::size_t iterations = 0;
+    double parse_seconds = 0;
+    double gather_seconds = 0;
+    double print_seconds = 0;
+    std::size_t printed = 0;
+    do
+    {
+        copy = page;
+
+        document_pool::activation activation(pool);
+
+        benchmark_clock::time_point start = benchmark_clock::now();
+        rapidxml::xml_document<> & doc = pool.reset(copy.size());
+        doc.parse<0>(&copy[0]);
+        parse_seconds += seconds_since(start);
+
+        string_table names;
+        start = benchmark_clock::now();
+        nodes_containers nodes(doc, names, op);
+        gather_seconds += seconds_since(start);
+
+        start = benchmark_clock::now();
+        file_writer writer(temp_path.string());
+        rapidxml::print(writer.iterator(), doc);
+        writer.close();
+        print_seconds += seconds_since(start);
+        printed = writer.size();
+
+        benchmark_sink += nodes.fails.size();
+        ++iterations;
+    } while ( parse_seconds + gather_seconds + print_seconds < min_seconds );
+
+    print_result("parse", name, page.size(), cells, iterations, parse_seconds);
+    print_result("gather_nodes", name, page.size(), cells, iterations, gather_seconds);
+    print_result("print", name, printed, cells, iterations, print_seconds);
+}
+
+int main(int argc, char **argv)
+{
+    std::string pages_dir = argc > 1 ? argv[1] : "example/pages";
+    double min_seconds = argc > 2 ? std::atof(argv[2]) : 0.5;
+    if ( min_seconds <= 0 )
+        min_seconds = 0.5;
+
+    options op;
+
+    print_header();
+
+    // logs
+    std::size_t const sizes[] = { 4 * 1024, 4 * 1024 * 1024 };
+    for ( std::size_t s = 0 ; s < sizeof(sizes) / sizeof(sizes[0]) ; ++s )
+    {
+        for ( std::size_t k = 0 ; k < sizeof(log_kinds) / sizeof(log_kinds[0]) ; ++k )
+        {
+            std::string log = make_log(log_kinds[k], sizes[s]);
+            std::stringstream name;
+            name << log_kinds[k].name << " " << sizes[s] / 1024 << "KB";
+
+            benchmark_find_reason(name.str(), log, op, min_seconds);
+            if ( log_kinds[k].marker == NULL )
+                benchmark_append_hrefs(name.str(), log, min_seconds);
+        }
+    }
+
+    // summary pages
+    try
+    {
+        boost::filesystem::path temp_path = boost::filesystem::temp_directory_path()
+                                          / boost::filesystem::unique_path();
+
+        std::vector<boost::filesystem::path> pages;
+        for ( boost::filesystem::directory_iterator it(pages_dir) ;
+              it != boost::filesystem::directory_iterator() ; ++it )
+        {
+            if ( it->path().extension() == ".html" )
+                pages.push_back(it->path());
+        }
+        std::sort(pages.begin(), pages.end());
+
+        BOOST_FOREACH(boost::filesystem::path const& path, pages)
+        {
+            std::ifstream ifs(path.string().c_str(), std::ios::binary);
+            std::string page((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+            benchmark_page(path.filename().string(), page, temp_path, op, min_seconds);
+        }
+
+        boost::filesystem::remove(temp_path);
+    }
+    catch (std::exception & e)
+    {
+        std::cerr << "Error reading pages: " << e.what() << std::endl;
+        return 1;
+    }
+
+    // the sink is used so the results are not discarded
+    return benchmark_sink == std::size_t(-1) ? 1 : 0;
+}
@@ -0,0 +1,164 @@
+// Copyright 2014 Adam Wulkiewicz.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef CLASSIFICATION_CACHE_HPP
+#define CLASSIFICATION_CACHE_HPP
+
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "atomic_file.hpp"
+#include "content_hash.hpp"
+
+// Results of classification of logs, identified by the hash of the content
+// The cache is valid only for the rules it was created with, entries not used
+// in the last runs are removed when the cache is saved.
+class classification_cache
+{
+public:
+    struct verdict
+    {
+        std::string reason;
+        std::string signature;
+        std::vector<std::string> nested_hrefs;
+
+    private:
+        template<class Archive>
+        void serialize(Archive & ar, const unsigned int version)
+        {
+            ar & reason;
+            ar & signature;
+            ar & nested_hrefs;
+        }
+
+        friend class boost::serialization::access;
+    };
+
+    classification_cache()
+        : enabled(false)
+        , rules_version(0)
+        , generation(0)
+    {}
+
+    // Enables the cache, entries of different rules are dropped
+    void load(std::string const& filename, boost::uint64_t rules_version_)
+    {
+        enabled = true;
+        rules_version = rules_version_;
+        generation = 0;
+        entries.clear();
+
+        std::ifstream ifs(filename.c_str(), std::ios::binary);
+        if ( !ifs.is_open() )
+            return;
+
+        boost::uint64_t version = 0;
+        unsigned int gen = 0;
+        std::map<boost::uint64_t, entry> e;
+
+        boost::archive::binary_iarchive ia(ifs);
+        ia >> version;
+        ia >> gen;
+        ia >> e;
+
+        if ( version == rules_version )
+        {
+            generation = gen + 1;
+            entries.swap(e);
+        }
+    }
+
+    void save(std::string const& filename) const
+    {
+        std::map<boost::uint64_t, entry> e;
+        for ( std::map<boost::uint64_t, entry>::const_iterator it = entries.begin() ;
+              it != entries.end() ; ++it )
+        {
+            if ( it->second.generation + max_unused_runs >= generation )
+                e.insert(*it);
+        }
+
+        {
+            std::ofstream ofs(temporary_path(filename).c_str(), std::ios::trunc | std::ios::binary);
+            if ( !ofs.is_open() )
+                throw std::runtime_error("unable to open file");
+
+            boost::archive::binary_oarchive oa(ofs);
+            oa << rules_version;
+            oa << generation;
+            oa << e;
+        }
+
+        replace_file(filename);
+    }
+
+    bool is_enabled() const
+    {
+        return enabled;
+    }
+
+    bool find(boost::uint64_t hash, verdict & v)
+    {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        std::map<boost::uint64_t, entry>::iterator it = entries.find(hash);
+        if ( it == entries.end() )
+            return false;
+        it->second.generation = generation;
+        v = it->second.result;
+        return true;
+    }
+
+    void insert(boost::uint64_t hash, verdict const& v)
+    {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        entry & e = entries[hash];
+        e.result = v;
+        e.generation = generation;
+    }
+
+private:
+    static const unsigned int max_unused_runs = 10;
+
+    struct entry
+    {
+        entry() : generation(0) {}
+
+        verdict result;
+        unsigned int generation; // of the last run using this entry
+
+    private:
+        template<class Archive>
+        void serialize(Archive & ar, const unsigned int version)
+        {
+            ar & result;
+            ar & generation;
+        }
+
+        friend class boost::serialization::access;
+    };
+
+    bool enabled;
+    boost::uint64_t rules_version;
+    unsigned int generation;
+
+    boost::mutex mutex;
+    std::map<boost::uint64_t, entry> entries;
+};
+
+#endif // CLASSIFICATION_CACHE_HPP
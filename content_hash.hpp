@@ -0,0 +1,62 @@
+// Copyright 2014 Adam Wulkiewicz.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef CONTENT_HASH_HPP
+#define CONTENT_HASH_HPP
+
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+#include <boost/cstdint.hpp>
+
+// 64-bit hash of the content, MurmurHash64A
+inline boost::uint64_t content_hash(char const* data, std::size_t size)
+{
+    boost::uint64_t const m = 0xc6a4a7935bd1e995ULL;
+    int const r = 47;
+
+    boost::uint64_t h = 0x5bd1e9955bd1e995ULL ^ (size * m);
+
+    char const* end = data + (size / 8) * 8;
+    for ( ; data != end ; data += 8 )
+    {
+        boost::uint64_t k;
+        std::memcpy(&k, data, 8);
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        h ^= k;
+        h *= m;
+    }
+
+    std::size_t rest = size & 7;
+    if ( rest > 0 )
+    {
+        boost::uint64_t k = 0;
+        for ( std::size_t i = rest ; i > 0 ; --i )
+            k = (k << 8) | static_cast<unsigned char>(data[i - 1]);
+        h ^= k;
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+
+    return h;
+}
+
+inline boost::uint64_t content_hash(std::string const& str)
+{
+    return content_hash(str.data(), str.size());
+}
+
+#endif // CONTENT_HASH_HPP
@@ -0,0 +1,150 @@
+// Copyright 2014 Adam Wulkiewicz.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef DOCUMENT_POOL_HPP
+#define DOCUMENT_POOL_HPP
+
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/tss.hpp>
+
+#include "rapidxml/rapidxml.hpp"
+
+// rapidxml document reusing its memory between parsed documents
+// Memory is allocated in big blocks which are released only when the pool is destroyed.
+// When the pool is reset blocks are merged into one block big enough for the next document.
+class document_pool
+    : boost::noncopyable
+{
+public:
+    typedef rapidxml::xml_document<> document_type;
+
+    // Makes the pool the source of memory for documents in the current thread,
+    // must be alive during parsing and modification of the document
+    class activation
+        : boost::noncopyable
+    {
+    public:
+        explicit activation(document_pool & pool)
+            : previous(active().get())
+        {
+            active().reset(&pool);
+        }
+
+        ~activation()
+        {
+            active().reset(previous);
+        }
+
+    private:
+        document_pool * previous;
+    };
+
+    document_pool()
+        : used(0)
+    {}
+
+    ~document_pool()
+    {
+        doc.clear();
+        release_blocks();
+    }
+
+    // Clears the document and reserves memory for input of given size
+    document_type & reset(std::size_t input_size)
+    {
+        doc.clear();
+
+        // rapidxml needs roughly 2.5 times more memory than the size of parsed page
+        std::size_t required = (std::max)(input_size * 3, used);
+        if ( blocks.size() > 1 || ( !blocks.empty() && blocks.front().size < required ) )
+            release_blocks();
+        if ( blocks.empty() && required > 0 )
+            add_block(required);
+
+        used = 0;
+        if ( !blocks.empty() )
+            blocks.front().used = 0;
+
+        doc.set_allocator(allocate, deallocate);
+        return doc;
+    }
+
+    document_type & document()
+    {
+        return doc;
+    }
+
+private:
+    struct block
+    {
+        block(char * data_, std::size_t size_)
+            : data(data_), size(size_), used(0)
+        {}
+
+        char * data;
+        std::size_t size;
+        std::size_t used;
+    };
+
+    void * allocate_impl(std::size_t size)
+    {
+        if ( blocks.empty() || blocks.back().size - blocks.back().used < size )
+        {
+            std::size_t block_size = blocks.empty() ? 0 : blocks.back().size;
+            add_block((std::max)(size, block_size));
+        }
+
+        block & b = blocks.back();
+        void * result = b.data + b.used;
+        b.used += size;
+        used += size;
+        return result;
+    }
+
+    void add_block(std::size_t size)
+    {
+        blocks.push_back(block(new char[size], size));
+    }
+
+    void release_blocks()
+    {
+        for ( std::vector<block>::iterator it = blocks.begin() ; it != blocks.end() ; ++it )
+            delete[] it->data;
+        blocks.clear();
+    }
+
+    static void * allocate(std::size_t size)
+    {
+        document_pool * pool = active().get();
+        if ( pool == NULL )
+            throw std::runtime_error("document pool not activated");
+        return pool->allocate_impl(size);
+    }
+
+    // memory is released in reset() and in destructor
+    static void deallocate(void *) {}
+
+    static void no_cleanup(document_pool *) {}
+
+    static boost::thread_specific_ptr<document_pool> & active()
+    {
+        static boost::thread_specific_ptr<document_pool> ptr(no_cleanup);
+        return ptr;
+    }
+
+    std::vector<block> blocks;
+    std::size_t used;
+
+    document_type doc;
+};
+
+#endif // DOCUMENT_POOL_HPP
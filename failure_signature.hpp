@@ -0,0 +1,190 @@
+// Copyright 2014 Adam Wulkiewicz.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef FAILURE_SIGNATURE_HPP
+#define FAILURE_SIGNATURE_HPP
+
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+namespace failure_signature_detail {
+
+inline bool is_word_char(char c)
+{
+    return ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' )
+        || ( c >= '0' && c <= '9' ) || c == '_';
+}
+
+inline bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\v';
+}
+
+inline bool is_line_end(char c)
+{
+    return c == '\n' || c == '\r' || c == '\f';
+}
+
+// "error" or "Error" as a separate word, e.g. not -Werror or error_code
+inline bool is_error_at(std::string const& log, std::size_t i)
+{
+    if ( i > 0 && ( is_word_char(log[i - 1]) || log[i - 1] == '-' ) )
+        return false;
+    if ( log[i] != 'e' && log[i] != 'E' )
+        return false;
+    std::size_t end = i + 5;
+    return end >= log.size() || !is_word_char(log[end]);
+}
+
+// Decodes the entity starting at s, returns its length or 0
+inline std::size_t decode_entity(char const* s, char const* last, char & c)
+{
+    static const struct { char const* str; char chr; } entities[] = {
+        { "&lt;", '<' }, { "&gt;", '>' }, { "&amp;", '&' }, { "&quot;", '"' }, { "&apos;", '\'' }
+    };
+    for ( std::size_t i = 0 ; i < sizeof(entities) / sizeof(entities[0]) ; ++i )
+    {
+        std::size_t len = std::strlen(entities[i].str);
+        if ( std::size_t(last - s) >= len && std::strncmp(s, entities[i].str, len) == 0 )
+        {
+            c = entities[i].chr;
+            return len;
+        }
+    }
+    return 0;
+}
+
+// Removes markup, decodes entities and replaces typographic quotes
+inline std::string plain_text(char const* first, char const* last)
+{
+    std::string result;
+    result.reserve(last - first);
+    while ( first != last )
+    {
+        char c = *first;
+        if ( c == '<' )
+        {
+            while ( first != last && *first != '>' )
+                ++first;
+            if ( first != last )
+                ++first;
+            continue;
+        }
+        if ( c == '&' )
+        {
+            std::size_t len = decode_entity(first, last, c);
+            if ( len > 0 )
+            {
+                result += c;
+                first += len;
+                continue;
+            }
+        }
+        // UTF-8 ‘ ’ “ ” used by GCC depending on the locale
+        if ( c == '\xE2' && last - first >= 3 && first[1] == '\x80'
+          && first[2] >= '\x98' && first[2] <= '\x9D' )
+        {
+            result += first[2] <= '\x9B' ? '\'' : '"';
+            first += 3;
+            continue;
+        }
+        result += c;
+        ++first;
+    }
+    return result;
+}
+
+} // namespace failure_signature_detail
+
+// Must be incremented whenever signatures are normalized differently, cached
+// signatures of other versions aren't used
+const unsigned int failure_signature_version = 1;
+
+// The first error line of the log with paths reduced to file names, numbers
+// (lines, columns, addresses) replaced with N and whitespace collapsed, so the
+// same error reported for different tests, runners and toolsets has the same
+// signature. Empty if the log contains no error line.
+inline std::string failure_signature(std::string const& log,
+                                     std::size_t max_length = 160)
+{
+    namespace fsd = failure_signature_detail;
+
+    std::size_t pos = 0;
+    for ( ;; )
+    {
+        pos = log.find("rror", pos);
+        if ( pos == std::string::npos )
+            return std::string();
+        if ( pos > 0 && fsd::is_error_at(log, pos - 1) )
+            break;
+        pos += 4;
+    }
+    --pos;
+
+    std::size_t line_begin = pos;
+    while ( line_begin > 0 && !fsd::is_line_end(log[line_begin - 1]) )
+        --line_begin;
+    std::size_t line_end = pos;
+    while ( line_end < log.size() && !fsd::is_line_end(log[line_end]) )
+        ++line_end;
+
+    std::string line = fsd::plain_text(log.data() + line_begin, log.data() + line_end);
+
+    std::string result;
+    std::size_t i = 0;
+    while ( i < line.size() && result.size() < max_length )
+    {
+        if ( fsd::is_space(line[i]) )
+        {
+            while ( i < line.size() && fsd::is_space(line[i]) )
+                ++i;
+            if ( !result.empty() && i < line.size() )
+                result += ' ';
+            continue;
+        }
+
+        // a token, paths are reduced to the last component
+        std::size_t token_end = i;
+        std::size_t name_begin = i;
+        while ( token_end < line.size() && !fsd::is_space(line[token_end]) )
+        {
+            if ( line[token_end] == '/' || line[token_end] == '\\' )
+                name_begin = token_end + 1;
+            ++token_end;
+        }
+
+        for ( std::size_t j = name_begin ; j < token_end ; )
+        {
+            char c = line[j];
+            if ( fsd::is_digit(c) && ( j == name_begin || !fsd::is_word_char(line[j - 1]) ) )
+            {
+                while ( j < token_end && fsd::is_word_char(line[j]) )
+                    ++j;
+                result += 'N';
+                continue;
+            }
+            result += c;
+            ++j;
+        }
+
+        i = token_end;
+    }
+
+    if ( result.size() > max_length )
+        result.resize(max_length);
+
+    return result;
+}
+
+#endif // FAILURE_SIGNATURE_HPP
@@ -0,0 +1,150 @@
+// Copyright 2014 Adam Wulkiewicz.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef FILE_WRITER_HPP
+#define FILE_WRITER_HPP
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+// Writes characters to a file through a big buffer
+// The buffer is passed directly to the file, the stream's own buffering is
+// disabled. iterator() may be used as an output iterator, e.g. with
+// rapidxml::print.
+class file_writer
+    : boost::noncopyable
+{
+public:
+    class output_iterator
+        : public std::iterator<std::output_iterator_tag, void, void, void, void>
+    {
+    public:
+        explicit output_iterator(file_writer & writer_) : writer(&writer_) {}
+
+        output_iterator & operator=(char c) { writer->put(c); return *this; }
+        output_iterator & operator*() { return *this; }
+        output_iterator & operator++() { return *this; }
+        output_iterator & operator++(int) { return *this; }
+
+    private:
+        file_writer * writer;
+    };
+
+    explicit file_writer(std::string const& filename,
+                         std::size_t buffer_size = 1024 * 1024)
+        : file(std::fopen(filename.c_str(), "w"))
+        , buffer(buffer_size > 0 ? buffer_size : 1)
+        , pos(&buffer[0])
+        , end(&buffer[0] + buffer.size())
+        , written(0)
+    {
+        if ( file == NULL )
+            throw std::runtime_error("unable to open file " + filename);
+        std::setvbuf(file, NULL, _IONBF, 0);
+    }
+
+    ~file_writer()
+    {
+        // close() should be called to check errors
+        if ( file != NULL )
+        {
+            try { flush_buffer(); } catch (...) {}
+            std::fclose(file);
+        }
+    }
+
+    void put(char c)
+    {
+        if ( pos == end )
+            flush_buffer();
+        *pos++ = c;
+    }
+
+    void write(char const* first, std::size_t size)
+    {
+        if ( size > std::size_t(end - pos) )
+        {
+            flush_buffer();
+            // big chunks are written directly
+            if ( size >= buffer.size() )
+            {
+                write_file(first, size);
+                return;
+            }
+        }
+        std::copy(first, first + size, pos);
+        pos += size;
+    }
+
+    void write(char const* str)
+    {
+        write(str, std::strlen(str));
+    }
+
+    void write(std::string const& str)
+    {
+        write(str.data(), str.size());
+    }
+
+    output_iterator iterator()
+    {
+        return output_iterator(*this);
+    }
+
+    // Flushes the buffer and closes the file, throws on error
+    void close()
+    {
+        if ( file == NULL )
+            return;
+
+        flush_buffer();
+        bool failed = std::fclose(file) != 0;
+        file = NULL;
+        if ( failed )
+            throw std::runtime_error("unable to write file");
+    }
+
+    // Number of bytes written so far
+    std::size_t size() const
+    {
+        return written + (pos - &buffer[0]);
+    }
+
+private:
+    void flush_buffer()
+    {
+        char * first = &buffer[0];
+        std::size_t size = pos - first;
+        pos = first;
+        if ( size > 0 )
+            write_file(first, size);
+    }
+
+    void write_file(char const* first, std::size_t size)
+    {
+        if ( std::fwrite(first, 1, size, file) != size )
+            throw std::runtime_error("unable to write file");
+        written += size;
+    }
+
+    std::FILE * file;
+    std::vector<char> buffer;
+    char * pos;
+    char * end;
+    std::size_t written;
+};
+
+#endif // FILE_WRITER_HPP
@@ -26,9 +26,16 @@ void send_request(std::string const& req, boost::asio::ip::tcp::socket & socket,
     boost::asio::write(socket, request);
 }
 
-void send_data(std::string const& data, boost::asio::ip::tcp::socket & socket)
+// The headers, the data and the end of data mark are sent without copying
+void send_data(std::string const& headers, std::string const& data, boost::asio::ip::tcp::socket & socket)
 {
-    send_request(data, socket, "\r\n.\r\n");
+    static const char end_mark[] = "\r\n.\r\n";
+
+    std::vector<boost::asio::const_buffer> buffers;
+    buffers.push_back(boost::asio::buffer(headers));
+    buffers.push_back(boost::asio::buffer(data));
+    buffers.push_back(boost::asio::buffer(end_mark, sizeof(end_mark) - 1));
+    boost::asio::write(socket, buffers);
 }
 
 void expect_response(unsigned code, boost::asio::ip::tcp::socket & socket)
@@ -107,9 +114,8 @@ void send(std::string const& host,
         ss << "Content-Type: text/plain; charset=UTF-8" << "\r\n";
     ss << "Subject: " << subject <<  "\r\n";
     ss << "\r\n";
-    ss << message;
 
-    send_data(ss.str(), socket);
+    send_data(ss.str(), message, socket);
 
     expect_response(250, socket);
     send_request("QUIT", socket);
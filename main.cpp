@@ -5,6 +5,8 @@
 // http://www.boost.org/LICENSE_1_0.txt)
 
 
+#include <cctype>
+#include <deque>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -12,18 +14,28 @@
 #include <set>
 
 #include <boost/algorithm/string/predicate.hpp>
-#include <boost/algorithm/string/regex.hpp>
 #include <boost/algorithm/string/trim.hpp>
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <boost/iterator/counting_iterator.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/optional.hpp>
 #include <boost/program_options.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <boost/archive/xml_iarchive.hpp>
 #include <boost/archive/xml_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/serialization/map.hpp>
+#include <boost/serialization/split_member.hpp>
 #include <boost/serialization/vector.hpp>
 
 #include <boost/network.hpp>
@@ -31,7 +43,17 @@
 #include "rapidxml/rapidxml.hpp"
 #include "rapidxml/rapidxml_print.hpp"
 
+#include "atomic_file.hpp"
+#include "background_compressor.hpp"
+#include "classification_cache.hpp"
+#include "content_hash.hpp"
+#include "document_pool.hpp"
+#include "failure_signature.hpp"
+#include "file_writer.hpp"
 #include "mail.hpp"
+#include "page_chunks.hpp"
+#include "reason_rules.hpp"
+#include "splice_printer.hpp"
 
 struct options
 {
@@ -41,9 +63,21 @@ struct options
         , send_report(false)
         , save_report(false)
         , log_format(xml)
+        , render(print)
+        , export_format(no_export)
         , output_dir("./")
+        , rules_path("reasons.cfg")
+        , cache_path("classifications.bin")
+        , cache_classifications(false)
+        , gzip(false)
+        , pivot_pages(false)
+        , chunk_rows(0)
         , connections(5)
         , retries(3)
+        , threads(1)
+        , classifiers(1)
+        , scan_head(64)
+        , scan_tail(64)
         , tests_url("http://www.boost.org/development/tests/")
         , branch("develop")
         , view("developer")
@@ -69,10 +103,22 @@ struct options
     bool send_report;
     bool save_report;
     enum { binary, xml } log_format;
+    enum { print, splice, compact } render;
+    enum { no_export, json, csv } export_format;
     std::string output_dir;
+    std::string rules_path;
+    std::string cache_path;
+    bool cache_classifications;
+    bool gzip;
+    bool pivot_pages;
+    std::size_t chunk_rows; // 0 - pages aren't split
 
     unsigned short connections;
     unsigned short retries;
+    unsigned short threads;
+    unsigned short classifiers;
+    std::size_t scan_head; // KB
+    std::size_t scan_tail; // KB
 
     std::string tests_url;
     std::string branch;
@@ -98,12 +144,23 @@ bool process_options(int argc, char **argv, options & op)
         ("help", "produce help message")
         ("connections", po::value<int>()->default_value(op.connections), "max number of connections [1..100]")
         ("retries", po::value<int>()->default_value(op.retries), "max number of retries [1..10]")
+        ("threads", po::value<int>()->default_value(op.threads), "number of libraries processed in parallel [1..64]")
+        ("classifiers", po::value<int>()->default_value(op.classifiers), "number of threads classifying logs of a library [0..64], 0 - classify in downloading thread")
+        ("scan-head", po::value<int>()->default_value(int(op.scan_head)), "KB at the beginning of a log checked first [1..102400]")
+        ("scan-tail", po::value<int>()->default_value(int(op.scan_tail)), "KB at the end of a log checked first [0..102400], the whole log is checked only if nothing was found")
         ("branch", po::value<std::string>()->default_value(op.branch), "branch name {develop, master}")
         ("track-changes", "compare failures with the previous run")
         ("log-format", po::value<std::string>()->default_value("xml"), "the format of failures log {xml, binary}")
+        ("render", po::value<std::string>()->default_value("print"), "the way of saving pages {print, splice, compact}, splice - modified elements are put into the original page, compact - minimal tables of results styled by compact.css")
         ("send-report", "send an email containing the report about the failures")
         ("save-report", "save report to file")
+        ("export", po::value<std::string>(), "export all classified cells and compared failures to file {json, csv}")
         ("output-dir", po::value<std::string>()->default_value(op.output_dir), "the directory for enhanced summary pages and report")
+        ("rules", po::value<std::string>()->default_value(op.rules_path), "the file containing failures classification rules")
+        ("cache-classifications", "reuse the classification of logs seen in the previous runs")
+        ("gzip", "save also gzip compressed pages and report (.html.gz)")
+        ("pivot-pages", "save also pages containing failures of all libraries for each toolset and runner")
+        ("chunk-rows", po::value<int>()->default_value(int(op.chunk_rows)), "number of tests in parts of pages loaded when they're scrolled into view [0..100000], 0 - pages aren't split")
         ("verbose", "show details")
         ;
 
@@ -143,6 +200,27 @@ bool process_options(int argc, char **argv, options & op)
     }
     op.log_format = lf == "binary" ? options::binary : options::xml;
 
+    std::string rn = vm["render"].as<std::string>();
+    if ( rn != "print" && rn != "splice" && rn != "compact" )
+    {
+        std::cerr << "Invalid render" << std::endl;
+        result = false;
+    }
+    op.render = rn == "splice" ? options::splice
+              : rn == "compact" ? options::compact
+              : options::print;
+
+    if ( vm.count("export") )
+    {
+        std::string ex = vm["export"].as<std::string>();
+        if ( ex != "json" && ex != "csv" )
+        {
+            std::cerr << "Invalid export format" << std::endl;
+            result = false;
+        }
+        op.export_format = ex == "csv" ? options::csv : options::json;
+    }
+
     int c = vm["connections"].as<int>();
     if ( c < 1 || 100 < c )
     {
@@ -159,6 +237,51 @@ bool process_options(int argc, char **argv, options & op)
     }
     op.retries = static_cast<unsigned short>(r);
 
+    int t = vm["threads"].as<int>();
+    if ( t < 1 || 64 < t )
+    {
+        std::cerr << "Invalid threads value" << std::endl;
+        result = false;
+    }
+    op.threads = static_cast<unsigned short>(t);
+
+    int cl = vm["classifiers"].as<int>();
+    if ( cl < 0 || 64 < cl )
+    {
+        std::cerr << "Invalid classifiers value" << std::endl;
+        result = false;
+    }
+    op.classifiers = static_cast<unsigned short>(cl);
+
+    int sh = vm["scan-head"].as<int>();
+    if ( sh < 1 || 102400 < sh )
+    {
+        std::cerr << "Invalid scan-head value" << std::endl;
+        result = false;
+    }
+    op.scan_head = static_cast<std::size_t>(sh);
+
+    int st = vm["scan-tail"].as<int>();
+    if ( st < 0 || 102400 < st )
+    {
+        std::cerr << "Invalid scan-tail value" << std::endl;
+        result = false;
+    }
+    op.scan_tail = static_cast<std::size_t>(st);
+
+    int cr = vm["chunk-rows"].as<int>();
+    if ( cr < 0 || 100000 < cr )
+    {
+        std::cerr << "Invalid chunk-rows value" << std::endl;
+        result = false;
+    }
+    else if ( cr > 0 && op.render != options::print )
+    {
+        std::cerr << "Pages can be split only with print render" << std::endl;
+        result = false;
+    }
+    op.chunk_rows = static_cast<std::size_t>(cr);
+
     std::string b = vm["branch"].as<std::string>();
     if ( b != "develop" && b != "master" )
     {
@@ -169,6 +292,17 @@ bool process_options(int argc, char **argv, options & op)
 
     op.output_dir = vm["output-dir"].as<std::string>();
 
+    op.rules_path = vm["rules"].as<std::string>();
+
+    if ( vm.count("cache-classifications") )
+        op.cache_classifications = true;
+
+    if ( vm.count("pivot-pages") )
+        op.pivot_pages = true;
+
+    if ( vm.count("gzip") )
+        op.gzip = true;
+
     op.refresh();
 
     return result;
@@ -216,62 +350,132 @@ T value_as(NorA * n, T def)
     return res;
 }
 
+// The string must outlive the document
 template <typename NorA>
-void set_value(rapidxml::xml_document<> & doc, NorA * n, const char* v)
+void set_value(NorA * n, const char* v)
 {
-    char * cstr = doc.allocate_string(v);
-
-    n->value(cstr);
+    n->value(v);
     if ( n->first_node("") )
-        n->first_node("")->value(cstr);
+        n->first_node("")->value(v);
+}
+
+template <typename NorA>
+void set_value(rapidxml::xml_document<> & doc, NorA * n, const char* v)
+{
+    set_value(n, doc.allocate_string(v));
 }
 
-struct log_node
+// Table of interned strings, each string is stored once and identified by index
+class string_table
+    : boost::noncopyable
 {
-    log_node(rapidxml::xml_node<> * td_,
-             rapidxml::xml_node<> * a_,
-             rapidxml::xml_attribute<> * href_,
-             std::string const& log_url_,
-             std::size_t toolset_index_,
-             std::string const& test_name_)
-        : td(td_), a(a_), href(href_), log_url(log_url_)
-        , toolset_index(toolset_index_)
-        , test_name(test_name_)
-    {}
-    rapidxml::xml_node<> * td;
-    rapidxml::xml_node<> * a;
-    rapidxml::xml_attribute<> * href;
-    std::string log_url;
-    std::size_t toolset_index;
-    std::string test_name;
+public:
+    typedef unsigned int id_type;
+
+    id_type intern(std::string const& str)
+    {
+        std::pair<map_type::iterator, bool>
+            res = ids.insert(std::make_pair(str, static_cast<id_type>(strings.size())));
+        if ( res.second )
+            strings.push_back(&res.first->first);
+        return res.first->second;
+    }
+
+    std::string const& str(id_type id) const
+    {
+        return *strings[id];
+    }
+
+    std::size_t size() const
+    {
+        return strings.size();
+    }
+
+private:
+    typedef boost::unordered_map<std::string, id_type> map_type;
+
+    map_type ids;
+    std::vector<std::string const*> strings;
 };
 
-struct fail_node
-    : log_node
+// Runners, toolsets and tests names of all libraries, ids stored in failures logs
+// Pages are processed with separate tables which are merged into this one.
+string_table & identifiers()
 {
-    fail_node(rapidxml::xml_node<> * td_,
-              rapidxml::xml_node<> * a_,
-              rapidxml::xml_attribute<> * href_,
-              std::string const& log_url_,
-              std::size_t toolset_index_,
-              std::string const& test_name_)
-        : log_node(td_, a_, href_, log_url_, toolset_index_, test_name_)
-    {}
-    
-    std::string reason;
-    std::string nested_reason;
+    static string_table table;
+    return table;
+}
+
+// Columnar storage of pass/fail cells
+// log urls are split into a shared prefix and a suffix stored in a common buffer
+struct cells_table
+{
+    typedef std::size_t index_type;
+    typedef boost::counting_iterator<index_type> iterator;
+
+    void push_back(rapidxml::xml_node<> * td,
+                   rapidxml::xml_node<> * a,
+                   rapidxml::xml_attribute<> * href,
+                   std::string const& log_url,
+                   std::size_t toolset_index,
+                   string_table::id_type test_name)
+    {
+        std::size_t prefix_size = log_url.find_last_of('/') + 1; // 0 if not found
+
+        if ( suffixes_offsets.empty() )
+            suffixes_offsets.push_back(0);
+
+        tds.push_back(td);
+        anchors.push_back(a);
+        hrefs.push_back(href);
+        url_prefixes.push_back(prefixes.intern(log_url.substr(0, prefix_size)));
+        suffixes.append(log_url, prefix_size, std::string::npos);
+        suffixes_offsets.push_back(suffixes.size());
+        toolset_indexes.push_back(static_cast<unsigned short>(toolset_index));
+        test_names.push_back(test_name);
+    }
+
+    std::string log_url(index_type i) const
+    {
+        return prefixes.str(url_prefixes[i])
+             + suffixes.substr(suffixes_offsets[i], suffixes_offsets[i + 1] - suffixes_offsets[i]);
+    }
+
+    std::size_t size() const { return tds.size(); }
+    bool empty() const { return tds.empty(); }
+
+    iterator begin() const { return iterator(0); }
+    iterator end() const { return iterator(size()); }
+
+    std::vector<rapidxml::xml_node<> *> tds;
+    std::vector<rapidxml::xml_node<> *> anchors;
+    std::vector<rapidxml::xml_attribute<> *> hrefs;
+    std::vector<string_table::id_type> url_prefixes;
+    std::vector<std::size_t> suffixes_offsets;
+    std::vector<unsigned short> toolset_indexes;
+    std::vector<string_table::id_type> test_names;
+
+    string_table prefixes;
+    std::string suffixes;
 };
 
-struct anchor_node
+struct fail_cells_table
+    : cells_table
 {
-    anchor_node(rapidxml::xml_node<> * a_,
-                rapidxml::xml_attribute<> * href_,
-                std::string const& url_)
-        : a(a_), href(href_), url(url_)
-    {}
-    rapidxml::xml_node<> * a;
-    rapidxml::xml_attribute<> * href;
-    std::string url;
+    void push_back(rapidxml::xml_node<> * td,
+                   rapidxml::xml_node<> * a,
+                   rapidxml::xml_attribute<> * href,
+                   std::string const& log_url,
+                   std::size_t toolset_index,
+                   string_table::id_type test_name)
+    {
+        cells_table::push_back(td, a, href, log_url, toolset_index, test_name);
+        reasons.push_back(reason_type());
+        nested_reasons.push_back(reason_type());
+    }
+
+    std::vector<reason_type> reasons;
+    std::vector<reason_type> nested_reasons;
 };
 
 bool not_slash(char c) { return c != '/' && c != '\\'; }
@@ -289,43 +493,75 @@ std::string to_global(std::string const& url, std::string const& global_prefix)
     return url;
 }
 
-struct nodes_containers
+void process_pass(rapidxml::xml_document<> & doc,
+                  rapidxml::xml_node<> * td,
+                  rapidxml::xml_node<> * a,
+                  rapidxml::xml_attribute<> * href,
+                  std::string const& log_url)
+{
+    // remove spaces
+    while ( td->first_node("") )
+    {
+        td->remove_node(td->first_node(""));
+    }
+
+    // set new, global href
+    href->value( doc.allocate_string(log_url.c_str()) );
+
+    set_value(a, "pass");
+}
+
+void process_anchor(rapidxml::xml_document<> & doc,
+                    rapidxml::xml_attribute<> * href,
+                    std::string const& url)
 {
-    typedef std::vector<log_node> passes_container;
-    typedef passes_container::iterator passes_iterator;
+    // set new, global href
+    href->value( doc.allocate_string(url.c_str()) );
+}
 
-    typedef std::vector<fail_node> fails_container;
+// Gathers fail cells and runners/toolsets names
+// Passes and non-log anchors don't require logs so they're processed in place.
+struct nodes_containers
+{
+    typedef fail_cells_table fails_container;
     typedef fails_container::iterator fails_iterator;
 
-    typedef std::vector<anchor_node> anchors_container;
-    typedef anchors_container::iterator anchors_iterator;
-
-    typedef std::vector<std::string> strings_container;
-    typedef strings_container::iterator strings_iterator;
+    typedef std::vector<string_table::id_type> ids_container;
+    typedef ids_container::iterator ids_iterator;
 
-    nodes_containers(rapidxml::xml_document<> & doc, options const& op)
+    nodes_containers(rapidxml::xml_document<> & doc, string_table & names, options const& op)
     {
-        gathering_state state;
+        gathering_state state(doc, names);
         gather_nodes(doc.first_node(), op, state);
     }
 
-    passes_container passes;
     fails_container fails;
-    anchors_container non_log_anchors;
 
-    strings_container runners;
-    strings_container toolsets;
+    ids_container runners;
+    ids_container toolsets;
+
+    // modified in place
+    std::vector<rapidxml::xml_node<> *> pass_anchors;
+    std::vector<rapidxml::xml_node<> *> other_anchors;
+
+    // <tr> of each test
+    std::vector<rapidxml::xml_node<> *> test_rows;
 
 private:
     struct gathering_state
     {
-        gathering_state()
-            : toolset_index(0)
+        gathering_state(rapidxml::xml_document<> & doc_, string_table & names_)
+            : doc(doc_)
+            , names(names_)
+            , toolset_index(0)
+            , test_name(names_.intern(""))
             , table_footer_counter(0)
         {}
 
+        rapidxml::xml_document<> & doc;
+        string_table & names;
         std::size_t toolset_index;
-        std::string test_name;
+        string_table::id_type test_name;
         int table_footer_counter;
     };
 
@@ -358,7 +594,7 @@ private:
 
                         std::string runner = value(a);
                         boost::trim(runner);
-                        runners.insert(runners.end(), colspan, runner);
+                        runners.insert(runners.end(), colspan, state.names.intern(runner));
                     }
                 }
             }
@@ -371,7 +607,7 @@ private:
                     // toolset <span>
                     std::string name = value(n->first_node("span"));
                     boost::trim(name);
-                    toolsets.push_back(name);
+                    toolsets.push_back(state.names.intern(name));
                 }
             }
             else if ( "test-name" == class_name )
@@ -381,8 +617,15 @@ private:
 
                 std::string test_name = value(n->first_node("a"));
                 boost::trim(test_name);
-                state.test_name = test_name;
+                state.test_name = state.names.intern(test_name);
                 state.toolset_index = 0;
+
+                // the name is at the beginning and at the end of the row
+                if ( state.table_footer_counter == 0 && n->parent()
+                  && ( test_rows.empty() || test_rows.back() != n->parent() ) )
+                {
+                    test_rows.push_back(n->parent());
+                }
             }
             else if ( "library-fail-unexpected-new" == class_name )
             {
@@ -403,7 +646,7 @@ private:
                         if ( !boost::starts_with(href_raw, "output/") )
                             href_raw = std::string("output/") + href_raw;
                         std::string global_href = to_global(href_raw, op.branch_url);
-                        fails.push_back(fail_node(n, anch, href_attr, global_href, state.toolset_index, state.test_name));
+                        fails.push_back(n, anch, href_attr, global_href, state.toolset_index, state.test_name);
                     }
                 }
 
@@ -428,7 +671,8 @@ private:
                         if ( !boost::starts_with(href_raw, "output/") )
                             href_raw = std::string("output/") + href_raw;
                         std::string global_href = to_global(href_raw, op.branch_url);
-                        passes.push_back(log_node(n, anch, href_attr, global_href, state.toolset_index, state.test_name));
+                        process_pass(state.doc, n, anch, href_attr, global_href);
+                        pass_anchors.push_back(anch);
                     }
                 }
 
@@ -450,7 +694,8 @@ private:
             if ( ( class_attr == NULL || value(class_attr) != "log-link") && href_attr )
             {
                 std::string global_href = to_global(value(href_attr), op.view_url);
-                non_log_anchors.push_back(anchor_node(n, href_attr, global_href));
+                process_anchor(state.doc, href_attr, global_href);
+                other_anchors.push_back(n);
             }
         }
         
@@ -575,90 +820,71 @@ struct logs_pool
     std::vector<element> responses;
 };
 
-inline bool find_string(std::string const& str, std::string const& str_to_find)
+// Classification rules, set before processing of the libraries
+reason_rules & classification_rules()
 {
-    return str.find(str_to_find) != std::string::npos;
+    static reason_rules rules;
+    return rules;
 }
 
-inline bool find_regex(std::string const& str, std::string const& regex)
+reason_type find_reason(std::string const& log, options const& op)
 {
-    return ! boost::empty(
-                boost::algorithm::find_regex(
-                    str,
-                    boost::basic_regex<char>(regex),
-                    boost::match_not_dot_newline
-                ));
+    return classification_rules().find_reason(log, op.scan_head * 1024, op.scan_tail * 1024);
 }
 
-std::string find_reason(std::string const& log)
+std::string filename_from_url(std::string const& url)
 {
-    // time limit exceeded
-    if ( find_string(log, "second time limit exceeded") )
-    {
-        return "time";
-    }
-    // File too big, /bigobj, No space left on device, etc.
-    else if ( find_regex(log, "((Fatal error: can't write)|(Fatal error: can't close)|(File too big)|(/bigobj)|(No matching files were found))") )
-    {
-        return "file";
-    }
-    // internal compiler error
-    else if ( find_regex(log, "((internal compiler error)|(internal error))") )
-    {
-        return "ierr";
-    }
-    // compilation failed
-    else if ( find_regex(log, "(Compile).+(fail).*$") )
-    {
-        return "comp";
-    }
-    // linking failed
-    else if ( find_regex(log, "(Link).+(fail).*$") )
+    return url.substr(url.find_last_of('/') + 1);
+}
+
+std::string escape_html(std::string const& str)
+{
+    std::string result;
+    result.reserve(str.size());
+    BOOST_FOREACH(char c, str)
     {
-        return "link";
+        switch ( c )
+        {
+        case '<': result += "&lt;"; break;
+        case '>': result += "&gt;"; break;
+        case '&': result += "&amp;"; break;
+        case '"': result += "&quot;"; break;
+        default: result += c;
+        }
     }
-    // run failed
-    else if ( find_regex(log, "(Run).+(fail).*$") )
+    return result;
+}
+
+std::string safe_filename(std::string const& name)
+{
+    std::string result = name;
+    BOOST_FOREACH(char & c, result)
     {
-        return "run";
+        if ( !std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_' && c != '.' )
+            c = '_';
     }
-
-    // unknown fail
-    return "unkn";
+    return result;
 }
 
-std::string filename_from_url(std::string const& url)
+std::string const& reason_to_style(reason_type reason)
 {
-    return url.substr(url.find_last_of('/') + 1);
+    return classification_rules().style(reason);
 }
 
-std::string reason_to_style(std::string const& reason)
-{
-    if ( reason == "time" )
-        return "background-color: #88ff00;";
-    else if ( reason == "file" )
-        return "background-color: #00ff88;";
-    else if ( reason == "ierr" )
-        return "background-color: #ff88ff;";
-    else if ( reason == "comp")
-        return "background-color: #ffbb00;";
-    else if ( reason == "link" )
-        return "background-color: #ffdd00;";
-    else if ( reason == "run" )
-        return "background-color: #ffff00;";
-    else if ( reason == "unkn" )
-        return "background-color: #ffff88;";
-    else
-        return "";
+std::string const& reason_label(reason_type reason)
+{
+    return classification_rules().label(reason);
 }
 
 struct fail_id
 {
-    fail_id() {}
+    typedef string_table::id_type id_type;
 
-    fail_id(std::string const& runner_,
-            std::string const& toolset_,
-            std::string const& test_name_)
+    fail_id() : runner(0), toolset(0), test_name(0) {}
+
+    fail_id(id_type runner_,
+            id_type toolset_,
+            id_type test_name_)
         : runner(runner_)
         , toolset(toolset_)
         , test_name(test_name_)
@@ -671,19 +897,55 @@ struct fail_id
                     || runner == r.runner && toolset < r.toolset );
     }
 
-    std::string runner;
-    std::string toolset;
-    std::string test_name;
+    // Compares names instead of ids, used where the order is visible
+    bool is_before_by_names(fail_id const& r) const
+    {
+        if ( test_name != r.test_name )
+            return test_name_str() < r.test_name_str();
+        if ( runner != r.runner )
+            return runner_str() < r.runner_str();
+        return toolset != r.toolset && toolset_str() < r.toolset_str();
+    }
+
+    bool operator==(fail_id const& r) const
+    {
+        return test_name == r.test_name && runner == r.runner && toolset == r.toolset;
+    }
+
+    std::string const& runner_str() const { return identifiers().str(runner); }
+    std::string const& toolset_str() const { return identifiers().str(toolset); }
+    std::string const& test_name_str() const { return identifiers().str(test_name); }
+
+    id_type runner;
+    id_type toolset;
+    id_type test_name;
 
 private:
+    // names are stored in the log, ids are valid only in the current run
     template<class Archive>
-    void serialize(Archive & ar, const unsigned int version)
+    void save(Archive & ar, const unsigned int version) const
+    {
+        ar & boost::serialization::make_nvp("runner", runner_str());
+        ar & boost::serialization::make_nvp("toolset", toolset_str());
+        ar & boost::serialization::make_nvp("test", test_name_str());
+    }
+
+    template<class Archive>
+    void load(Archive & ar, const unsigned int version)
     {
-        ar & boost::serialization::make_nvp("runner", runner);
-        ar & boost::serialization::make_nvp("toolset", toolset);
-        ar & boost::serialization::make_nvp("test", test_name);
+        std::string runner_;
+        std::string toolset_;
+        std::string test_name_;
+        ar & boost::serialization::make_nvp("runner", runner_);
+        ar & boost::serialization::make_nvp("toolset", toolset_);
+        ar & boost::serialization::make_nvp("test", test_name_);
+        runner = identifiers().intern(runner_);
+        toolset = identifiers().intern(toolset_);
+        test_name = identifiers().intern(test_name_);
     }
 
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
     friend class boost::serialization::access;
 };
 
@@ -691,42 +953,92 @@ struct fail_data
 {
     fail_data() {}
 
-    fail_data(std::string const& reason_,
-              std::string const& url_)
+    fail_data(reason_type reason_,
+              std::string const& url_,
+              std::string const& signature_)
         : reason(reason_)
         , url(url_)
+        , signature(signature_)
     {}
 
-    std::string reason;
+    reason_type reason;
     std::string url;
+    std::string signature; // not stored in the log
 
 private:
+    // reasons are stored as labels
     template<class Archive>
-    void serialize(Archive & ar, const unsigned int version)
+    void save(Archive & ar, const unsigned int version) const
+    {
+        ar & boost::serialization::make_nvp("reason", reason_label(reason));
+    }
+
+    template<class Archive>
+    void load(Archive & ar, const unsigned int version)
     {
-        ar & boost::serialization::make_nvp("reason", reason);
+        std::string label;
+        ar & boost::serialization::make_nvp("reason", label);
+        reason = classification_rules().find_or_add(label);
     }
 
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
     friend class boost::serialization::access;
 };
 
-bool is_reason_important(std::string const& reason)
+// Classified fail cell of a summary page
+struct cell_info
+{
+    cell_info() {}
+
+    cell_info(fail_id const& id_,
+              reason_type reason_,
+              reason_type nested_reason_,
+              std::string const& url_)
+        : id(id_)
+        , reason(reason_)
+        , nested_reason(nested_reason_)
+        , url(url_)
+    {}
+
+    // the reason shown on the page
+    reason_type displayed_reason() const
+    {
+        return nested_reason.empty() ? reason : nested_reason;
+    }
+
+    fail_id id;
+    reason_type reason;
+    reason_type nested_reason; // empty if no nested log was classified
+    std::string url;
+};
+
+bool is_reason_important(reason_type reason)
+{
+    return classification_rules().is_important(reason);
+}
+
+int reason_importance(reason_type reason)
 {
-    return reason == "comp" || reason == "link" || reason == "run" || reason == "unkn";
+    return classification_rules().importance(reason);
 }
 
-int reason_importance(std::string const& reason)
+struct is_more_important
+{
+    bool operator()(reason_type l, reason_type r) const
+    {
+        return reason_importance(l) > reason_importance(r);
+    }
+};
+
+classification_cache & classifications()
 {
-    return reason == "comp" ? 6 :
-           reason == "link" ? 5 :
-           reason == "run"  ? 4 :
-           reason == "unkn" ? 3 :
-           reason == "ierr" ? 2 :
-           reason == "file" ? 1 :
-           reason == "time" ? 0 : -1;
+    static classification_cache cache;
+    return cache;
 }
 
-void append_urls_impl(rapidxml::xml_node<> * n, std::vector<std::string> & urls, options const& op)
+// hrefs are relative to op.branch_url + "output/"
+void append_hrefs_impl(rapidxml::xml_node<> * n, std::vector<std::string> & hrefs)
 {
     if ( n == NULL )
         return;
@@ -739,28 +1051,29 @@ void append_urls_impl(rapidxml::xml_node<> * n, std::vector<std::string> & urls,
             std::string url = value(href);
             if ( !url.empty() )
             {
-                urls.push_back(op.branch_url + "output/" + url);
+                hrefs.push_back(url);
                 //urls.push_back(to_global(url, op.branch_url + "output/"));
             }
         }
     }
     
     // depth first
-    append_urls_impl(n->first_node(), urls, op);
-    append_urls_impl(n->next_sibling(), urls, op);
+    append_hrefs_impl(n->first_node(), hrefs);
+    append_hrefs_impl(n->next_sibling(), hrefs);
 }
 
-void append_urls(std::string & page, std::vector<std::string> & urls, options const& op)
+void append_hrefs(std::string & page, std::vector<std::string> & hrefs, document_pool & pool)
 {
     if ( page.empty() )
         return;
 
     try
     {
-        rapidxml::xml_document<> doc;
+        document_pool::activation activation(pool);
+        rapidxml::xml_document<> & doc = pool.reset(page.size());
         doc.parse<0>(&page[0]); // non-98-standard but should work
 
-        append_urls_impl(doc.first_node(), urls, op);
+        append_hrefs_impl(doc.first_node(), hrefs);
     }
     catch (...)
     {
@@ -768,219 +1081,638 @@ void append_urls(std::string & page, std::vector<std::string> & urls, options co
     }
 }
 
+// Documents reused for all processed pages and logs of a thread processing
+// libraries, including logs classified by its classifier threads
+struct document_pools
+    : boost::noncopyable
+{
+    explicit document_pools(std::size_t classifiers)
+        : classifier_logs(new document_pool[classifiers])
+    {}
+
+    document_pool page;
+    document_pool log; // logs classified in this thread
+    boost::scoped_array<document_pool> classifier_logs; // one per classifier thread
+};
+
+// Classifies logs on worker threads
+// Logs are pushed by the thread downloading them and results are collected
+// and applied to the document by the same thread. For logs of unknown failures
+// the urls of nested logs are extracted if needed.
+template <typename Id>
+class classifier_pool
+    : boost::noncopyable
+{
+public:
+    struct result
+    {
+        Id id;
+        reason_type reason;
+        std::string signature;
+        std::vector<std::string> urls;
+    };
+
+    // pools must contain at least op.classifiers pools of classifiers
+    classifier_pool(options const& op_, bool extract_urls_, document_pools & pools_)
+        : op(op_)
+        , extract_urls(extract_urls_)
+        , pools(pools_)
+        , pending_count(0)
+        , stopped(false)
+    {
+        for ( unsigned short i = 0 ; i < op.classifiers ; ++i )
+            threads.create_thread(boost::bind(&classifier_pool::worker, this, i));
+    }
+
+    ~classifier_pool()
+    {
+        {
+            boost::lock_guard<boost::mutex> lock(mutex);
+            stopped = true;
+        }
+        logs_condition.notify_all();
+        threads.join_all();
+    }
+
+    // The content of the log is moved to the pool
+    void push(Id const& id, std::string & log)
+    {
+        // no workers, classify in this thread
+        if ( op.classifiers == 0 )
+        {
+            result res;
+            classify(id, log, res, pools.log);
+
+            boost::lock_guard<boost::mutex> lock(mutex);
+            results.push_back(res);
+            ++pending_count;
+            return;
+        }
+
+        {
+            boost::lock_guard<boost::mutex> lock(mutex);
+            logs.push_back(std::make_pair(id, std::string()));
+            logs.back().second.swap(log);
+            ++pending_count;
+        }
+        logs_condition.notify_one();
+    }
+
+    // Gets classified logs, if wait is true blocks until at least one log is available
+    template <typename OutIt>
+    void get(OutIt out, bool wait)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while ( wait && results.empty() && pending_count > 0 )
+            results_condition.wait(lock);
+
+        std::copy(results.begin(), results.end(), out);
+        pending_count -= results.size();
+        results.clear();
+    }
+
+    // Number of logs pushed and not yet returned by get(), including
+    // classified logs waiting in the results
+    std::size_t pending() const
+    {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        return pending_count;
+    }
+
+private:
+    void worker(std::size_t index)
+    {
+        // memory of nested documents is reused for all logs classified by this thread
+        document_pool & pool = pools.classifier_logs[index];
+
+        for (;;)
+        {
+            std::pair<Id, std::string> log;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while ( logs.empty() && !stopped )
+                    logs_condition.wait(lock);
+                if ( logs.empty() )
+                    return;
+                log.first = logs.front().first;
+                log.second.swap(logs.front().second);
+                logs.pop_front();
+            }
+
+            result res;
+            classify(log.first, log.second, res, pool);
+
+            {
+                boost::lock_guard<boost::mutex> lock(mutex);
+                results.push_back(res);
+            }
+            results_condition.notify_one();
+        }
+    }
+
+    void classify(Id const& id, std::string & log, result & res, document_pool & pool) const
+    {
+        res.id = id;
+
+        classification_cache & cache = classifications();
+        if ( !cache.is_enabled() )
+        {
+            res.reason = find_reason(log, op);
+            res.signature = failure_signature(log);
+            if ( extract_urls && res.reason == classification_rules().fallback_reason() )
+            {
+                std::vector<std::string> hrefs;
+                append_hrefs(log, hrefs, pool);
+                append_urls(hrefs, res.urls);
+            }
+            return;
+        }
+
+        // the same log may be classified in both stages so nested logs are
+        // always extracted for the cache
+        boost::uint64_t hash = content_hash(log);
+        classification_cache::verdict v;
+        if ( cache.find(hash, v) )
+            res.reason = classification_rules().find(v.reason);
+
+        if ( res.reason.empty() )
+        {
+            res.reason = find_reason(log, op);
+            v.reason = reason_label(res.reason);
+            v.signature = failure_signature(log);
+            v.nested_hrefs.clear();
+            if ( res.reason == classification_rules().fallback_reason() )
+                append_hrefs(log, v.nested_hrefs, pool);
+            cache.insert(hash, v);
+        }
+
+        res.signature = v.signature;
+        if ( extract_urls && res.reason == classification_rules().fallback_reason() )
+            append_urls(v.nested_hrefs, res.urls);
+    }
+
+    void append_urls(std::vector<std::string> const& hrefs, std::vector<std::string> & urls) const
+    {
+        BOOST_FOREACH(std::string const& href, hrefs)
+            urls.push_back(op.branch_url + "output/" + href);
+    }
+
+    options const& op;
+    bool extract_urls;
+    document_pools & pools;
+
+    mutable boost::mutex mutex;
+    boost::condition_variable logs_condition;
+    boost::condition_variable results_condition;
+    std::deque<std::pair<Id, std::string> > logs;
+    std::vector<result> results;
+    std::size_t pending_count;
+    bool stopped;
+
+    boost::thread_group threads;
+};
+
 void process_fail(rapidxml::xml_document<> & doc,
-                  fail_node & n,
-                  std::string const& reason,
+                  fail_cells_table & fails,
+                  fail_cells_table::index_type i,
+                  reason_type reason,
+                  std::string const& signature,
                   options const& op)
 {
+    rapidxml::xml_node<> * td = fails.tds[i];
+
     // remove spaces
-    while ( n.td->first_node("") )
+    while ( td->first_node("") )
     {
-        n.td->remove_node(n.td->first_node(""));
+        td->remove_node(td->first_node(""));
     }
 
+    std::string log_url = fails.log_url(i);
+
     // set new, global href
-    n.href->value( doc.allocate_string(n.log_url.c_str()) );
+    fails.hrefs[i]->value( doc.allocate_string(log_url.c_str()) );
 
     if ( op.verbose )
-        std::cout << "Processing: " << filename_from_url(n.log_url) << std::endl;
+        std::cout << "Processing: " << filename_from_url(log_url) << std::endl;
 
     // remove old style if needed
-    rapidxml::xml_attribute<> * old_style_attr = n.td->first_attribute("style");
+    rapidxml::xml_attribute<> * old_style_attr = td->first_attribute("style");
     if ( old_style_attr )
-        n.td->remove_attribute(old_style_attr);
+        td->remove_attribute(old_style_attr);
 
-    // create new style
-    rapidxml::xml_attribute<> * style_attr = doc.allocate_attribute("style", doc.allocate_string(reason_to_style(reason).c_str()));
-    n.td->append_attribute(style_attr);
+    // create new style, strings of the rules outlive the document
+    rapidxml::xml_attribute<> * style_attr = doc.allocate_attribute("style", reason_to_style(reason).c_str());
+    td->append_attribute(style_attr);
 
-    set_value(doc, n.a, reason.c_str());
-}
+    set_value(fails.anchors[i], reason_label(reason).c_str());
 
-void process_pass(rapidxml::xml_document<> & doc,
-                  log_node & n)
-{
-    // remove spaces
-    while ( n.td->first_node("") )
+    // the signature of the error is shown on hover over the reason
+    rapidxml::xml_node<> * a = fails.anchors[i];
+    rapidxml::xml_attribute<> * old_title_attr = a->first_attribute("title");
+    if ( old_title_attr )
+        a->remove_attribute(old_title_attr);
+    if ( !signature.empty() )
     {
-        n.td->remove_node(n.td->first_node(""));
+        rapidxml::xml_attribute<> * title_attr = doc.allocate_attribute("title", doc.allocate_string(signature.c_str()));
+        a->append_attribute(title_attr);
     }
-
-    // set new, global href
-    n.href->value( doc.allocate_string(n.log_url.c_str()) );
-
-    set_value(doc, n.a, "pass");
-}
-
-void process_anchor(rapidxml::xml_document<> & doc, anchor_node & n)
-{
-    // set new, global href
-    n.href->value( doc.allocate_string(n.url.c_str()) );
 }
 
+// A cell referencing a nested log
 struct nested_failure
 {
-    nested_failure(nodes_containers::fails_iterator fail_it_,
-                   std::string url_,
+    nested_failure(fail_cells_table::index_type fail_index_,
                    boost::optional<std::map<fail_id, fail_data>::iterator> const& failure_it_)
-        : fail_it(fail_it_)
-        , url(url_)
+        : fail_index(fail_index_)
         , failure_it(failure_it_)
     {}
 
-    nodes_containers::fails_iterator fail_it;
-    std::string url;
+    fail_cells_table::index_type fail_index;
     boost::optional<std::map<fail_id, fail_data>::iterator> failure_it;
 };
 
-std::string const& fail_node_to_url(fail_node const& f)
+// A nested log downloaded and classified once for all cells referencing it
+struct nested_log
 {
-    return f.log_url;
-}
+    explicit nested_log(std::string const& url_) : url(url_) {}
 
-std::string const& nested_failure_to_url(nested_failure const& f)
-{
-    return f.url;
-}
+    std::string url;
+    std::vector<nested_failure> failures;
+};
 
-void process_document(std::string const& library_name,
-                      std::string & in,
-                      std::string & out,
-                      std::map<fail_id, fail_data> & failures,
-                      options const& op)
+struct fail_cell_to_url
 {
-    out.clear();
-    if ( in.empty() )
-        return;
+    explicit fail_cell_to_url(fail_cells_table const& fails_) : fails(fails_) {}
 
-    rapidxml::xml_document<> doc;
+    std::string operator()(fail_cells_table::index_type i) const
+    {
+        return fails.log_url(i);
+    }
+
+    fail_cells_table const& fails;
+};
+
+std::string const& nested_log_to_url(nested_log const& l)
+{
+    return l.url;
+}
+
+// Short CSS classes of results in compact pages, classified failures have
+// classes r-<reason>
+struct compact_class
+{
+    const char* name; // the class of <td> in the summary page
+    const char* code;
+    bool text; // the text of the result is shown
+};
+
+const compact_class compact_classes[] = {
+    { "library-success-expected", "p", false },
+    { "library-success-unexpected", "up", true },
+    { "library-fail-expected", "xf", true },
+    { "library-fail-expected-unresearched", "xf", true },
+    { "library-unusable", "na", true },
+    { "library-missing", "m", false },
+    { "library-fail-unexpected", "f", true },
+    { "library-fail-unexpected-new", "f", true }
+};
+
+std::string compact_reason_class(reason_type reason)
+{
+    return "r-" + safe_filename(reason_label(reason));
+}
+
+// Shared by all compact pages
+std::string compact_stylesheet()
+{
+    std::stringstream ss;
+    ss << "table.compact { border-collapse: collapse; font-family: sans-serif; font-size: 9pt; }\n"
+       << "table.compact th, table.compact td { border: 1px solid #cccccc; padding: 0px 2pt; text-align: center; }\n"
+       << "table.compact th.test { text-align: left; font-weight: normal; }\n"
+       << "td.p { background-color: lightgreen; }\n"
+       << "td.up { background-color: green; color: white; }\n"
+       << "td.xf, td.na { background-color: silver; }\n"
+       << "td.m { background-color: white; }\n"
+       << "td.f { background-color: red; }\n";
+
+    // reasons defined by the rules
+    for ( std::size_t i = 0 ; i < classification_rules().size() ; ++i )
+    {
+        reason_type reason = reason_type::from_index(i);
+        if ( !reason_to_style(reason).empty() )
+            ss << "td." << compact_reason_class(reason) << " { " << reason_to_style(reason) << " }\n";
+    }
+
+    return ss.str();
+}
+
+// Prints the table of results of the processed page, only test names, names of
+// runners and toolsets and the results are printed
+void print_compact(rapidxml::xml_document<> & doc,
+                   nodes_containers const& nodes,
+                   string_table const& names,
+                   std::string & out)
+{
+    std::string title;
+    rapidxml::xml_node<> * html = doc.first_node("html");
+    rapidxml::xml_node<> * head = html ? html->first_node("head") : NULL;
+    if ( head )
+        title = value(head->first_node("title"));
+    boost::trim(title);
+    title = escape_html(title);
+
+    out += "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.0 Transitional//EN\""
+           " \"http://www.w3.org/TR/xhtml1/DTD/xhtml1-transitional.dtd\">\n"
+           "<html xmlns=\"http://www.w3.org/1999/xhtml\"><head><title>";
+    out += title;
+    out += "</title><meta http-equiv=\"Content-Type\" content=\"text/html; charset=utf-8\"/>"
+           "<link rel=\"stylesheet\" type=\"text/css\" href=\"../compact.css\"/></head>\n<body><h2>";
+    out += title;
+    out += "</h2>\n<table class=\"compact\">\n";
+
+    // runners, consecutive toolsets of a runner are grouped
+    out += "<tr><th></th>";
+    for ( std::size_t i = 0 ; i < nodes.runners.size() ; )
+    {
+        std::size_t j = i + 1;
+        while ( j < nodes.runners.size() && nodes.runners[j] == nodes.runners[i] )
+            ++j;
+        out += "<th colspan=\"" + boost::lexical_cast<std::string>(j - i) + "\">";
+        out += escape_html(names.str(nodes.runners[i]));
+        out += "</th>";
+        i = j;
+    }
+    out += "</tr>\n<tr><th></th>";
+    BOOST_FOREACH(string_table::id_type id, nodes.toolsets)
+    {
+        out += "<th>";
+        out += escape_html(names.str(id));
+        out += "</th>";
+    }
+    out += "</tr>\n";
+
+    // fails are in the document order
+    nodes_containers::fails_iterator fail_it = nodes.fails.begin();
+
+    BOOST_FOREACH(rapidxml::xml_node<> * row, nodes.test_rows)
+    {
+        bool name_printed = false;
+        out += "<tr>";
+        for ( rapidxml::xml_node<> * td = row->first_node("td") ; td ; td = td->next_sibling("td") )
+        {
+            std::string class_name = value(td->first_attribute("class"));
+
+            if ( "test-name" == class_name )
+            {
+                if ( name_printed )
+                    continue;
+                name_printed = true;
+
+                rapidxml::xml_node<> * a = td->first_node("a");
+                std::string name = value(a);
+                boost::trim(name);
+                std::string href = a ? value(a->first_attribute("href")) : std::string();
+                out += "<th class=\"test\">";
+                if ( !href.empty() )
+                    out += "<a href=\"" + escape_html(href) + "\">" + escape_html(name) + "</a>";
+                else
+                    out += escape_html(name);
+                out += "</th>";
+            }
+            else if ( boost::starts_with(class_name, "library-") )
+            {
+                // classified failure
+                if ( fail_it != nodes.fails.end() && nodes.fails.tds[*fail_it] == td )
+                {
+                    fail_cells_table::index_type i = *fail_it++;
+                    reason_type reason = nodes.fails.nested_reasons[i].empty()
+                                       ? nodes.fails.reasons[i]
+                                       : nodes.fails.nested_reasons[i];
+                    if ( !reason.empty() )
+                    {
+                        out += "<td class=\"" + compact_reason_class(reason) + "\">"
+                             + "<a href=\"" + escape_html(nodes.fails.log_url(i)) + "\">"
+                             + escape_html(reason_label(reason)) + "</a></td>";
+                        continue;
+                    }
+                }
+
+                compact_class const* c = NULL;
+                BOOST_FOREACH(compact_class const& cc, compact_classes)
+                {
+                    if ( class_name == cc.name )
+                    {
+                        c = &cc;
+                        break;
+                    }
+                }
+
+                out += "<td class=\"";
+                out += c ? c->code : "o";
+                out += "\">";
+                if ( c == NULL || c->text )
+                {
+                    rapidxml::xml_node<> * a = td->first_node("a");
+                    std::string text = a ? value(a) : value(td);
+                    boost::trim(text);
+                    out += escape_html(text);
+                }
+                out += "</td>";
+            }
+        }
+        out += "</tr>\n";
+    }
+
+    out += "</table>\n</body></html>\n";
+}
+
+// The processed document is left in pools.page, it references the input
+// Modified elements are passed to the splice printer if it's not NULL.
+// The compact page is printed to compact if it's not NULL.
+void process_document(std::string & in,
+                      std::map<fail_id, fail_data> & failures,
+                      std::vector<cell_info> & cells,
+                      string_table & names,
+                      document_pools & pools,
+                      splice_printer * splice,
+                      std::vector<rapidxml::xml_node<> *> * test_rows,
+                      std::string * compact,
+                      options const& op)
+{
+    if ( in.empty() )
+        return;
+
+    document_pool::activation activation(pools.page);
+    rapidxml::xml_document<> & doc = pools.page.reset(in.size());
     doc.parse<0>(&in[0]); // non-98-standard but should work
 
-    nodes_containers nodes(doc, op);
+    nodes_containers nodes(doc, names, op);
     
-    std::vector<nested_failure> nested_failures;
+    std::vector<nested_log> nested_logs;
+    std::map<std::string, std::size_t> nested_logs_indexes;
 
     // process fails
     {
         typedef logs_pool<nodes_containers::fails_iterator> logs_pool_t;
+        typedef classifier_pool<fail_cells_table::index_type> classifier_pool_t;
 
         logs_pool_t pool(op);
+        classifier_pool_t classifier(op, true, pools);
     
         nodes_containers::fails_iterator it = nodes.fails.begin();
 
-        while ( it != nodes.fails.end() || !pool.responses.empty() )
+        while ( it != nodes.fails.end() || !pool.responses.empty() || classifier.pending() > 0 )
         {
-            // new portion of logs
-            nodes_containers::fails_iterator new_it = pool.add(it, nodes.fails.end(), fail_node_to_url);
+            bool downloading = it != nodes.fails.end() || !pool.responses.empty();
 
-            // print log names
-            if ( op.verbose )
+            if ( downloading )
             {
-                for ( ; it != new_it ; ++it )
-                    std::cout << "Downloading: " << filename_from_url(it->log_url) << std::endl;
-            }
+                // new portion of logs
+                nodes_containers::fails_iterator new_it = pool.add(it, nodes.fails.end(), fail_cell_to_url(nodes.fails));
 
-            // move "it" iterator to a new position
-            it = new_it;
+                // print log names
+                if ( op.verbose )
+                {
+                    for ( ; it != new_it ; ++it )
+                        std::cout << "Downloading: " << filename_from_url(nodes.fails.log_url(*it)) << std::endl;
+                }
+
+                // move "it" iterator to a new position
+                it = new_it;
+
+                // wait a while
+                boost::this_thread::sleep(boost::posix_time::milliseconds(100));
 
-            // wait a while
-            boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+                // get downloaded logs and pass them to the classifier
+                std::vector<logs_pool_t::log_info> logs;
+                pool.get(std::back_inserter(logs));
+
+                for ( std::vector<logs_pool_t::log_info>::iterator log_it = logs.begin() ;
+                      log_it != logs.end() ; ++log_it )
+                {
+                    classifier.push(*log_it->it, log_it->log);
+                }
+            }
 
-            // get downloaded logs
-            std::vector<logs_pool_t::log_info> logs;
-            pool.get(std::back_inserter(logs));
+            // get classified logs, wait for them if everything was downloaded
+            std::vector<classifier_pool_t::result> results;
+            classifier.get(std::back_inserter(results), !downloading);
 
-            for ( std::vector<logs_pool_t::log_info>::iterator log_it = logs.begin() ;
-                  log_it != logs.end() ; ++log_it )
+            for ( std::vector<classifier_pool_t::result>::iterator res_it = results.begin() ;
+                  res_it != results.end() ; ++res_it )
             {
-                std::string reason = find_reason(log_it->log);
-                log_it->it->reason = reason;
+                fail_cells_table::index_type fail_index = res_it->id;
+
+                reason_type reason = res_it->reason;
+                nodes.fails.reasons[fail_index] = reason;
 
                 boost::optional<std::map<fail_id, fail_data>::iterator> new_failure_it;
 
-                process_fail(doc, *(log_it->it), reason, op);
+                process_fail(doc, nodes.fails, fail_index, reason, res_it->signature, op);
 
-                if ( op.track_changes || op.save_report || op.send_report )
+                if ( op.track_changes || op.save_report || op.send_report || op.export_format != options::no_export )
                 {
                     // log only "important" errors
                     if ( is_reason_important(reason) )
                     {
                         new_failure_it
                             = failures.insert(std::make_pair(
-                                fail_id(nodes.runners[log_it->it->toolset_index],
-                                        nodes.toolsets[log_it->it->toolset_index],
-                                        log_it->it->test_name),
+                                fail_id(nodes.runners[nodes.fails.toolset_indexes[fail_index]],
+                                        nodes.toolsets[nodes.fails.toolset_indexes[fail_index]],
+                                        nodes.fails.test_names[fail_index]),
                                 fail_data(reason,
-                                          log_it->it->log_url))).first;
+                                          nodes.fails.log_url(fail_index),
+                                          res_it->signature))).first;
                     }
                 }
 
-                if ( reason == "unkn" )
+                BOOST_FOREACH(std::string const& url, res_it->urls)
                 {
-                    std::vector<std::string> urls;
-                    append_urls(log_it->log, urls, op);
-                    BOOST_FOREACH(std::string const& url, urls)
-                    {
-                        nested_failures.push_back(nested_failure(
-                                log_it->it,
-                                url,
-                                new_failure_it));
-                    }
-                }
+                    std::pair<std::map<std::string, std::size_t>::iterator, bool>
+                        index_it = nested_logs_indexes.insert(std::make_pair(url, nested_logs.size()));
+                    if ( index_it.second )
+                        nested_logs.push_back(nested_log(url));
 
+                    nested_logs[index_it.first->second].failures.push_back(
+                        nested_failure(fail_index, new_failure_it));
+                }
             }
         }
     }
 
     // process nested failures
     {
-        typedef logs_pool<std::vector<nested_failure>::iterator> logs_pool_t;
+        typedef logs_pool<std::vector<nested_log>::iterator> logs_pool_t;
+        typedef classifier_pool<std::vector<nested_log>::iterator> classifier_pool_t;
 
         logs_pool_t pool(op);
+        classifier_pool_t classifier(op, false, pools);
 
         std::vector<fail_id> modified_failures_ids;
 
-        std::vector<nested_failure>::iterator it = nested_failures.begin();
+        std::vector<nested_log>::iterator it = nested_logs.begin();
 
-        while ( it != nested_failures.end() || !pool.responses.empty() )
+        while ( it != nested_logs.end() || !pool.responses.empty() || classifier.pending() > 0 )
         {
-            // new portion of logs
-            std::vector<nested_failure>::iterator new_it = pool.add(it, nested_failures.end(), nested_failure_to_url);
+            bool downloading = it != nested_logs.end() || !pool.responses.empty();
 
-            // print log names
-            if ( op.verbose )
+            if ( downloading )
             {
-                for ( ; it != new_it ; ++it )
-                    std::cout << "Downloading: " << filename_from_url(it->url) << std::endl;
-            }
+                // new portion of logs
+                std::vector<nested_log>::iterator new_it = pool.add(it, nested_logs.end(), nested_log_to_url);
+
+                // print log names
+                if ( op.verbose )
+                {
+                    for ( ; it != new_it ; ++it )
+                        std::cout << "Downloading: " << filename_from_url(it->url) << std::endl;
+                }
+
+                // move "it" iterator to a new position
+                it = new_it;
+
+                // wait a while
+                boost::this_thread::sleep(boost::posix_time::milliseconds(100));
 
-            // move "it" iterator to a new position
-            it = new_it;
+                // get downloaded logs and pass them to the classifier
+                std::vector<logs_pool_t::log_info> logs;
+                pool.get(std::back_inserter(logs));
 
-            // wait a while
-            boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+                for ( std::vector<logs_pool_t::log_info>::iterator log_it = logs.begin() ;
+                      log_it != logs.end() ; ++log_it )
+                {
+                    classifier.push(log_it->it, log_it->log);
+                }
+            }
 
-            // get downloaded logs
-            std::vector<logs_pool_t::log_info> logs;
-            pool.get(std::back_inserter(logs));
+            // get classified logs, wait for them if everything was downloaded
+            std::vector<classifier_pool_t::result> results;
+            classifier.get(std::back_inserter(results), !downloading);
 
-            for ( std::vector<logs_pool_t::log_info>::iterator log_it = logs.begin() ;
-                log_it != logs.end() ; ++log_it )
+            for ( std::vector<classifier_pool_t::result>::iterator res_it = results.begin() ;
+                  res_it != results.end() ; ++res_it )
             {
-                std::string reason = find_reason(log_it->log);
+                reason_type reason = res_it->reason;
 
-                if ( /*log_it->it->fail_it->reason == "unkn" &&*/
-                     reason_importance(reason)
-                        > reason_importance(log_it->it->fail_it->nested_reason) )
+                // the result is applied to all cells referencing the log
+                BOOST_FOREACH(nested_failure const& f, res_it->id->failures)
                 {
-                    log_it->it->fail_it->nested_reason = reason;
-
-                    process_fail(doc, *(log_it->it->fail_it), reason, op);
+                    fail_cells_table::index_type fail_index = f.fail_index;
 
-                    if ( log_it->it->failure_it )
+                    if ( /*nodes.fails.reasons[fail_index] == "unkn" &&*/
+                         reason_importance(reason)
+                            > reason_importance(nodes.fails.nested_reasons[fail_index]) )
                     {
-                        modified_failures_ids.push_back((*log_it->it->failure_it)->first);
-                        (*(log_it->it->failure_it))->second.reason = reason;
+                        nodes.fails.nested_reasons[fail_index] = reason;
+
+                        process_fail(doc, nodes.fails, fail_index, reason, res_it->signature, op);
+
+                        if ( f.failure_it )
+                        {
+                            modified_failures_ids.push_back((*f.failure_it)->first);
+                            (*f.failure_it)->second.reason = reason;
+                            (*f.failure_it)->second.signature = res_it->signature;
+                        }
                     }
                 }
             }
@@ -998,29 +1730,48 @@ void process_document(std::string const& library_name,
         }
     }
 
-    // process passes
-    for ( nodes_containers::passes_iterator p_it = nodes.passes.begin() ;
-          p_it != nodes.passes.end() ; ++p_it )
+    // keep all classified cells
+    BOOST_FOREACH(fail_cells_table::index_type i, nodes.fails)
     {
-        process_pass(doc, *p_it);
+        if ( ! nodes.fails.reasons[i].empty() )
+        {
+            cells.push_back(cell_info(fail_id(nodes.runners[nodes.fails.toolset_indexes[i]],
+                                              nodes.toolsets[nodes.fails.toolset_indexes[i]],
+                                              nodes.fails.test_names[i]),
+                                      nodes.fails.reasons[i],
+                                      nodes.fails.nested_reasons[i],
+                                      nodes.fails.log_url(i)));
+        }
     }
 
-    // process anchors
-    for ( nodes_containers::anchors_iterator a_it = nodes.non_log_anchors.begin() ;
-          a_it != nodes.non_log_anchors.end() ; ++a_it )
+    if ( splice != NULL )
     {
-        process_anchor(doc, *a_it);
+        BOOST_FOREACH(fail_cells_table::index_type i, nodes.fails)
+        {
+            if ( ! nodes.fails.reasons[i].empty() )
+            {
+                splice->add(nodes.fails.tds[i], false);
+                splice->add(nodes.fails.anchors[i], true);
+            }
+        }
+        BOOST_FOREACH(rapidxml::xml_node<> * a, nodes.pass_anchors)
+            splice->add(a, true);
+        BOOST_FOREACH(rapidxml::xml_node<> * a, nodes.other_anchors)
+            splice->add(a, false);
     }
 
-    std::cout << "Saving: " << library_name << std::endl;
+    if ( compact != NULL )
+        print_compact(doc, nodes, names, *compact);
 
-    rapidxml::print(std::back_inserter(out), doc);
+    if ( test_rows != NULL )
+        test_rows->swap(nodes.test_rows);
 }
 
 struct library_fail_info
 {
     std::string library;
     std::map<fail_id, fail_data> failures;
+    std::vector<cell_info> cells; // not stored in the log
 
 private:
     template<class Archive>
@@ -1033,6 +1784,269 @@ private:
     friend class boost::serialization::access;
 };
 
+// Replaces the file with the written temporary file if it's changed
+bool replace_saved(std::string const& filename,
+                   file_writer const& writer,
+                   boost::posix_time::ptime const& start,
+                   options const& op)
+{
+    bool changed = replace_file_if_changed(filename);
+
+    if ( op.verbose )
+    {
+        boost::posix_time::time_duration d = boost::posix_time::microsec_clock::universal_time() - start;
+        double seconds = (std::max)(d.total_microseconds(), boost::posix_time::time_duration::tick_type(1)) / 1e6;
+        std::cout << ( changed ? "Saved: " : "Unchanged: " ) << filename_from_url(filename) << " "
+                  << writer.size() << " bytes in " << d.total_milliseconds() << " ms ("
+                  << writer.size() / seconds / (1024 * 1024) << " MB/s)" << std::endl;
+    }
+
+    return changed;
+}
+
+// Prints the document directly to the file, an empty file is created if there
+// is no document. Returns true if the file was changed.
+bool save_document(std::string const& filename,
+                   rapidxml::xml_document<> const* doc,
+                   options const& op)
+{
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+    file_writer writer(temporary_path(filename));
+    if ( doc != NULL )
+        rapidxml::print(writer.iterator(), *doc);
+    writer.close();
+
+    return replace_saved(filename, writer, start, op);
+}
+
+// Writes the original page with modified elements
+bool save_document(std::string const& filename,
+                   splice_printer & splice,
+                   options const& op)
+{
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+    file_writer writer(temporary_path(filename));
+    splice.print(writer);
+    writer.close();
+
+    return replace_saved(filename, writer, start, op);
+}
+
+// Saves generated page if it's changed and adds it to the compressor
+void save_generated(std::string const& filename,
+                    std::string const& content,
+                    background_compressor & compressor,
+                    options const& op)
+{
+    file_writer writer(temporary_path(filename));
+    writer.write(content);
+    writer.close();
+
+    bool changed = replace_file_if_changed(filename);
+
+    if ( op.gzip && ( changed || background_compressor::is_outdated(filename) ) )
+        compressor.add(filename);
+}
+
+// Writes the page printed before
+bool save_document(std::string const& filename,
+                   std::string const& page,
+                   options const& op)
+{
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+    file_writer writer(temporary_path(filename));
+    writer.write(page);
+    writer.close();
+
+    return replace_saved(filename, writer, start, op);
+}
+
+// Processes libraries in parallel, each thread with its own documents
+// Names of runners, toolsets and tests are interned in per-library tables
+// and merged into identifiers() in alphabetical order, so ids are the same
+// regardless of the number of threads and failures ordered by ids are ordered
+// by names.
+class libraries_processor
+{
+    struct library_result
+    {
+        library_result() : processed(false) {}
+
+        bool processed;
+        string_table names;
+        std::map<fail_id, fail_data> failures;
+        std::vector<cell_info> cells;
+    };
+
+public:
+    libraries_processor(options const& op_, background_compressor & compressor_)
+        : op(op_)
+        , compressor(compressor_)
+        , next_library(0)
+        , results(op_.libraries.size())
+    {}
+
+    void run(std::vector<library_fail_info> & failures)
+    {
+        std::size_t threads_count = (std::min)(std::size_t(op.threads), op.libraries.size());
+
+        if ( threads_count <= 1 )
+        {
+            worker();
+        }
+        else
+        {
+            boost::thread_group threads;
+            for ( std::size_t i = 0 ; i < threads_count ; ++i )
+                threads.create_thread(boost::bind(&libraries_processor::worker, this));
+            threads.join_all();
+        }
+
+        // names of all libraries are interned in alphabetical order
+        std::set<std::string> all_names;
+        for ( std::size_t i = 0 ; i < results.size() ; ++i )
+        {
+            for ( string_table::id_type id = 0 ; id < results[i].names.size() ; ++id )
+                all_names.insert(results[i].names.str(id));
+        }
+        BOOST_FOREACH(std::string const& name, all_names)
+            identifiers().intern(name);
+
+        // merge failures in the order of libraries
+        failures.resize(op.libraries.size());
+        for ( std::size_t i = 0 ; i < results.size() ; ++i )
+        {
+            string_table const& names = results[i].names;
+            std::vector<string_table::id_type> global_ids(names.size());
+            for ( string_table::id_type id = 0 ; id < names.size() ; ++id )
+                global_ids[id] = identifiers().intern(names.str(id));
+
+            failures[i].failures.clear();
+            for ( std::map<fail_id, fail_data>::const_iterator it = results[i].failures.begin() ;
+                  it != results[i].failures.end() ; ++it )
+            {
+                fail_id id(global_ids[it->first.runner],
+                           global_ids[it->first.toolset],
+                           global_ids[it->first.test_name]);
+                failures[i].failures.insert(std::make_pair(id, it->second));
+            }
+
+            failures[i].cells.clear();
+            failures[i].cells.reserve(results[i].cells.size());
+            BOOST_FOREACH(cell_info const& cell, results[i].cells)
+            {
+                failures[i].cells.push_back(cell);
+                fail_id & id = failures[i].cells.back().id;
+                id = fail_id(global_ids[id.runner], global_ids[id.toolset], global_ids[id.test_name]);
+            }
+
+            // set library name, empty if processing failed
+            failures[i].library = results[i].processed ? op.libraries[i] : std::string();
+        }
+    }
+
+private:
+    void worker()
+    {
+        // memory of the documents is reused for all libraries processed by this thread
+        document_pools pools(op.classifiers);
+
+        for (;;)
+        {
+            std::size_t i = 0;
+            {
+                boost::lock_guard<boost::mutex> lock(mutex);
+                if ( next_library >= op.libraries.size() )
+                    return;
+                i = next_library++;
+            }
+
+            results[i].processed = process_library(op.libraries[i], results[i], pools);
+        }
+    }
+
+    bool process_library(std::string const& lib, library_result & result, document_pools & pools)
+    {
+        try
+        {
+            std::string url = op.view_url + lib + "_.html";
+
+            if ( op.verbose )
+                std::cout << "Downloading: " << lib << std::endl;
+            else
+                std::cout << "Processing: " << lib << std::endl;
+
+            // download the summary page
+            std::string body = get_document(url);
+
+            if ( op.verbose )
+                std::cout << "Processing: " << lib << std::endl;
+
+            // the page is parsed in situ, the original is needed for splicing
+            std::string original;
+            boost::scoped_ptr<splice_printer> splice;
+            if ( op.render == options::splice )
+            {
+                original = body;
+                splice.reset(new splice_printer(body.data(), original));
+            }
+
+            // process the summary page
+            std::vector<rapidxml::xml_node<> *> test_rows;
+            std::string compact;
+            process_document(body, result.failures, result.cells, result.names, pools, splice.get(),
+                             op.chunk_rows > 0 ? &test_rows : NULL,
+                             op.render == options::compact ? &compact : NULL,
+                             op);
+
+            // save processed summary page
+            std::cout << "Saving: " << lib << std::endl;
+
+            std::string of_name = op.output_dir + "pages/" + op.branch + '-' + lib + ".html";
+
+            // tests are moved to separate files, the page is modified
+            if ( !test_rows.empty() )
+            {
+                document_pool::activation activation(pools.page);
+
+                std::vector<page_chunk> chunks;
+                std::string chunks_dir = op.branch + '-' + lib;
+                split_into_chunks(pools.page.document(), test_rows, chunks_dir, op.chunk_rows, "../chunks.js", chunks);
+
+                boost::filesystem::create_directories(op.output_dir + "pages/" + chunks_dir);
+                BOOST_FOREACH(page_chunk const& chunk, chunks)
+                    save_generated(op.output_dir + "pages/" + chunk.path, chunk.content, compressor, op);
+            }
+            bool changed = splice ? save_document(of_name, *splice, op)
+                         : op.render == options::compact ? save_document(of_name, compact, op)
+                         : save_document(of_name, body.empty() ? NULL : &pools.page.document(), op);
+
+            if ( op.gzip && ( changed || background_compressor::is_outdated(of_name) ) )
+                compressor.add(of_name);
+
+            return true;
+        }
+        catch (std::exception & e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+
+            result.failures.clear();
+            result.cells.clear();
+            return false;
+        }
+    }
+
+    options const& op;
+    background_compressor & compressor;
+
+    boost::mutex mutex;
+    std::size_t next_library;
+    std::vector<library_result> results;
+};
+
 struct compared_fail_info
 {
     typedef boost::optional<std::map<fail_id, fail_data>::const_iterator> optional_fail_iterator;
@@ -1052,6 +2066,18 @@ struct compared_fail_info
     optional_fail_iterator previous_fail_it;
 };
 
+// Orders failures by libraries and then by names, failures no longer present
+// may have names interned after the current ones so their ids aren't ordered
+struct is_previous_fail_before
+{
+    bool operator()(compared_fail_info const& l, compared_fail_info const& r) const
+    {
+        if ( l.library_it != r.library_it )
+            return l.library_it < r.library_it;
+        return (*l.previous_fail_it)->first.is_before_by_names((*r.previous_fail_it)->first);
+    }
+};
+
 struct is_same_library
 {
     std::string library;
@@ -1134,6 +2160,8 @@ void compare_failures_logs(std::vector<library_fail_info> const& previous_failur
             }
         }
     }
+
+    std::stable_sort(no_longer_errors.begin(), no_longer_errors.end(), is_previous_fail_before());
 }
 
 void output_errors(std::vector<compared_fail_info> const& errors,
@@ -1160,9 +2188,9 @@ void output_errors(std::vector<compared_fail_info> const& errors,
 
         std::string test_name;        
         if ( it->fail_it )
-            test_name = (*it->fail_it)->first.test_name;
+            test_name = (*it->fail_it)->first.test_name_str();
         else if ( it->previous_fail_it )
-            test_name = (*it->previous_fail_it)->first.test_name;
+            test_name = (*it->previous_fail_it)->first.test_name_str();
 
         if ( test_name != prev_test )
         {
@@ -1182,21 +2210,21 @@ void output_errors(std::vector<compared_fail_info> const& errors,
         if ( it->previous_fail_it )
         {
             os << "<span style=\"text-decoration: line-through; " << reason_to_style((*it->previous_fail_it)->second.reason) << "\">"
-               << (*it->previous_fail_it)->second.reason << "</span>";
+               << reason_label((*it->previous_fail_it)->second.reason) << "</span>";
 
             if ( it->fail_it )
                 os << "->";
         }
         if ( it->fail_it )
         {
-            os << "<span style=\"" << reason_to_style((*it->fail_it)->second.reason) << "\">" << (*it->fail_it)->second.reason << "</span>";
+            os << "<span style=\"" << reason_to_style((*it->fail_it)->second.reason) << "\">" << reason_label((*it->fail_it)->second.reason) << "</span>";
         }
 
         os << "</td><td>";
         if ( it->fail_it )
-            os << "<a href=\"" << (*it->fail_it)->second.url << "\">" << (*it->fail_it)->first.toolset << " (" << (*it->fail_it)->first.runner << ")</a>";
+            os << "<a href=\"" << (*it->fail_it)->second.url << "\">" << (*it->fail_it)->first.toolset_str() << " (" << (*it->fail_it)->first.runner_str() << ")</a>";
         else if ( it->previous_fail_it )
-            os << (*it->previous_fail_it)->first.toolset << " (" << (*it->previous_fail_it)->first.runner << ")";
+            os << (*it->previous_fail_it)->first.toolset_str() << " (" << (*it->previous_fail_it)->first.runner_str() << ")";
         os << "</td></tr>";
 
         prev_library = it->library_it->library;
@@ -1211,6 +2239,109 @@ void output_errors(std::vector<compared_fail_info> const& errors,
     }
 }
 
+// Failures of a library having the same reason and signature
+struct failure_cluster
+{
+    failure_cluster(std::vector<library_fail_info>::const_iterator const& library_it_,
+                    reason_type reason_,
+                    std::string const& signature_)
+        : library_it(library_it_)
+        , reason(reason_)
+        , signature(signature_)
+    {}
+
+    std::vector<library_fail_info>::const_iterator library_it;
+    reason_type reason;
+    std::string signature;
+    std::vector<compared_fail_info> members;
+};
+
+// Moves failures having the same signature as some other failure of the library
+// to clusters, the rest of failures is copied to remaining errors
+void cluster_errors(std::vector<compared_fail_info> const& errors,
+                    std::vector<failure_cluster> & clusters,
+                    std::vector<compared_fail_info> & remaining)
+{
+    typedef std::vector<compared_fail_info>::const_iterator iterator;
+    typedef std::map<std::pair<std::size_t, std::string>, std::size_t> indexes_map;
+
+    iterator lib_first = errors.begin();
+    while ( lib_first != errors.end() )
+    {
+        iterator lib_last = lib_first;
+        while ( lib_last != errors.end() && lib_last->library_it == lib_first->library_it )
+            ++lib_last;
+
+        // group failures of the library
+        std::vector<failure_cluster> lib_clusters;
+        std::vector<std::size_t> cluster_indexes;
+        indexes_map indexes;
+        for ( iterator it = lib_first ; it != lib_last ; ++it )
+        {
+            std::size_t index = lib_clusters.size();
+            if ( it->fail_it && !(*it->fail_it)->second.signature.empty() )
+            {
+                fail_data const& data = (*it->fail_it)->second;
+                std::pair<indexes_map::iterator, bool> ins
+                    = indexes.insert(std::make_pair(std::make_pair(data.reason.index(), data.signature),
+                                                    index));
+                if ( ins.second )
+                    lib_clusters.push_back(failure_cluster(it->library_it, data.reason, data.signature));
+                index = ins.first->second;
+                lib_clusters[index].members.push_back(*it);
+            }
+            cluster_indexes.push_back(index);
+        }
+
+        for ( std::size_t i = 0 ; i < lib_clusters.size() ; ++i )
+        {
+            if ( lib_clusters[i].members.size() > 1 )
+                clusters.push_back(lib_clusters[i]);
+        }
+
+        for ( iterator it = lib_first ; it != lib_last ; ++it )
+        {
+            std::size_t index = cluster_indexes[it - lib_first];
+            if ( index >= lib_clusters.size() || lib_clusters[index].members.size() <= 1 )
+                remaining.push_back(*it);
+        }
+
+        lib_first = lib_last;
+    }
+}
+
+void output_clusters(std::vector<failure_cluster> const& clusters,
+                     std::ostream & os)
+{
+    std::string prev_library;
+    BOOST_FOREACH(failure_cluster const& cluster, clusters)
+    {
+        if ( cluster.library_it->library != prev_library )
+            os << "<h3>" << cluster.library_it->library << "</h3>";
+
+        os << "<div style=\"margin:10px;\">";
+        os << "<span style=\"" << reason_to_style(cluster.reason) << "\">" << reason_label(cluster.reason) << "</span> ";
+        os << "<span style=\"font-weight: bold;\">" << cluster.members.size() << " failures:</span> ";
+        os << "<code>" << escape_html(cluster.signature) << "</code>";
+        os << "<div style=\"margin:5px;\">";
+        os << "<table style=\"border-width: 0px;\">";
+
+        BOOST_FOREACH(compared_fail_info const& member, cluster.members)
+        {
+            std::map<fail_id, fail_data>::const_iterator fail_it = *member.fail_it;
+            os << "<tr><td>" << fail_it->first.test_name_str() << "</td><td>"
+               << "<a href=\"" << fail_it->second.url << "\">" << fail_it->first.toolset_str() << " (" << fail_it->first.runner_str() << ")</a>"
+               << "</td></tr>";
+        }
+
+        os << "</table>";
+        os << "</div>";
+        os << "</div>";
+
+        prev_library = cluster.library_it->library;
+    }
+}
+
 void output_report(std::vector<compared_fail_info> const& new_errors,
                    std::vector<compared_fail_info> const& changed_errors,
                    std::vector<compared_fail_info> const& no_longer_errors,
@@ -1234,16 +2365,37 @@ void output_report(std::vector<compared_fail_info> const& new_errors,
        << no_longer_errors.size() << " failures dissapeared."
        << "</div>";
 
-    if ( ! new_errors.empty() )
+    // failures with the same cause are reported once
+    std::vector<failure_cluster> new_clusters;
+    std::vector<compared_fail_info> new_remaining;
+    cluster_errors(new_errors, new_clusters, new_remaining);
+
+    std::vector<failure_cluster> changed_clusters;
+    std::vector<compared_fail_info> changed_remaining;
+    cluster_errors(changed_errors, changed_clusters, changed_remaining);
+
+    if ( ! new_clusters.empty() )
     {
-        os << "<h2>New errors:</h2>";
-        output_errors(new_errors, os);
+        os << "<h2>Common causes of new errors:</h2>";
+        output_clusters(new_clusters, os);
     }
 
-    if ( ! changed_errors.empty() )
+    if ( ! new_remaining.empty() )
     {
-        os << "<h2>Changed errors:</h2>";
-        output_errors(changed_errors, os);
+        os << "<h2>New errors:</h2>";
+        output_errors(new_remaining, os);
+    }
+
+    if ( ! changed_clusters.empty() )
+    {
+        os << "<h2>Common causes of changed errors:</h2>";
+        output_clusters(changed_clusters, os);
+    }
+
+    if ( ! changed_remaining.empty() )
+    {
+        os << "<h2>Changed errors:</h2>";
+        output_errors(changed_remaining, os);
     }
 
     if ( ! no_longer_errors.empty() )
@@ -1255,6 +2407,452 @@ void output_report(std::vector<compared_fail_info> const& new_errors,
     os << "</body></html>";
 }
 
+// Failed cells of all libraries grouped by toolset or runner
+struct pivot_index
+{
+    struct entry
+    {
+        entry(std::size_t library_, cell_info const* cell_)
+            : library(library_), cell(cell_)
+        {}
+
+        std::size_t library; // index in failures
+        cell_info const* cell;
+    };
+
+    struct group
+    {
+        std::string path; // relative to the output directory
+        std::vector<entry> entries;
+    };
+
+    explicit pivot_index(std::string const& kind_)
+        : kind(kind_)
+    {}
+
+    std::string kind; // toolset or runner, the directory is kind + "s"
+    std::map<std::string, group> groups;
+};
+
+// Groups the cells kept while processing the pages in one pass and sets
+// unique paths of the pages
+void build_pivot_indexes(std::vector<library_fail_info> const& failures,
+                         pivot_index & toolsets,
+                         pivot_index & runners,
+                         options const& op)
+{
+    for ( std::size_t i = 0 ; i < failures.size() ; ++i )
+    {
+        BOOST_FOREACH(cell_info const& cell, failures[i].cells)
+        {
+            toolsets.groups[cell.id.toolset_str()].entries.push_back(pivot_index::entry(i, &cell));
+            runners.groups[cell.id.runner_str()].entries.push_back(pivot_index::entry(i, &cell));
+        }
+    }
+
+    pivot_index * indexes[] = { &toolsets, &runners };
+    BOOST_FOREACH(pivot_index * index, indexes)
+    {
+        // different names may be the same after replacing characters
+        std::set<std::string> paths;
+        for ( std::map<std::string, pivot_index::group>::iterator it = index->groups.begin() ;
+              it != index->groups.end() ; ++it )
+        {
+            std::string base = index->kind + "s/" + op.branch + '-' + safe_filename(it->first);
+            std::string path = base + ".html";
+            for ( std::size_t n = 2 ; !paths.insert(path).second ; ++n )
+                path = base + '-' + boost::lexical_cast<std::string>(n) + ".html";
+            it->second.path = path;
+        }
+    }
+}
+
+// Failures of all libraries for one toolset or runner
+void output_pivot(pivot_index const& index,
+                  std::map<std::string, pivot_index::group>::const_iterator group_it,
+                  std::vector<library_fail_info> const& failures,
+                  std::ostream & os,
+                  options const& op)
+{
+    bool is_toolset = index.kind == "toolset";
+    std::vector<pivot_index::entry> const& entries = group_it->second.entries;
+
+    std::vector<std::size_t> counts(classification_rules().size(), 0);
+    BOOST_FOREACH(pivot_index::entry const& e, entries)
+    {
+        std::size_t r = e.cell->displayed_reason().index();
+        if ( r < counts.size() )
+            ++counts[r];
+    }
+
+    std::vector<reason_type> reasons;
+    for ( std::size_t r = 0 ; r < counts.size() ; ++r )
+    {
+        if ( counts[r] > 0 )
+            reasons.push_back(reason_type::from_index(r));
+    }
+    std::stable_sort(reasons.begin(), reasons.end(), is_more_important());
+
+    std::string title = escape_html(group_it->first);
+
+    os << "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.0 Transitional//EN\""
+       << " \"http://www.w3.org/TR/xhtml1/DTD/xhtml1-transitional.dtd\">"
+       << "<html xmlns=\"http://www.w3.org/1999/xhtml\">"
+       << "<head><title>" << op.branch << ' ' << index.kind << ": " << title << "</title>"
+       << "<meta http-equiv=\"Content-Type\" content=\"text/html; charset=utf-8\"/>"
+       << "</head><body>";
+
+    os << "<h2>" << op.branch << ' ' << index.kind << ": " << title << "</h2>";
+
+    os << "<div style=\"margin:10px;\">" << entries.size() << " failures:";
+    BOOST_FOREACH(reason_type reason, reasons)
+        os << " <span style=\"" << reason_to_style(reason) << "\">" << escape_html(reason_label(reason)) << "</span> " << counts[reason.index()];
+    os << "</div>";
+
+    // entries are in the order of libraries
+    std::size_t prev_library = failures.size();
+    BOOST_FOREACH(pivot_index::entry const& e, entries)
+    {
+        if ( e.library != prev_library )
+        {
+            if ( prev_library != failures.size() )
+                os << "</table></div>";
+
+            std::string lib = escape_html(failures[e.library].library);
+            os << "<h3><a href=\"../pages/" << op.branch << '-' << lib << ".html\">" << lib << "</a></h3>";
+            os << "<div style=\"margin:10px;\">";
+            os << "<table style=\"border-width: 0px;\">";
+            prev_library = e.library;
+        }
+
+        reason_type reason = e.cell->displayed_reason();
+        fail_id const& id = e.cell->id;
+        os << "<tr><td>" << escape_html(id.test_name_str()) << "</td><td>"
+           << "<a href=\"" << escape_html(e.cell->url) << "\" style=\"" << reason_to_style(reason) << "\">" << escape_html(reason_label(reason)) << "</a>"
+           << "</td><td>" << escape_html(is_toolset ? id.runner_str() : id.toolset_str()) << "</td></tr>";
+    }
+
+    if ( prev_library != failures.size() )
+        os << "</table></div>";
+
+    os << "</body></html>";
+}
+
+void output_pivot_links(pivot_index const& index,
+                        std::ostream & os)
+{
+    os << "<h3>" << index.kind << "s</h3>";
+    os << "<div style=\"margin:10px;\">";
+    os << "<table style=\"border-width: 0px;\">";
+    for ( std::map<std::string, pivot_index::group>::const_iterator it = index.groups.begin() ;
+          it != index.groups.end() ; ++it )
+    {
+        os << "<tr><td><a href=\"" << escape_html(it->second.path) << "\">" << escape_html(it->first) << "</a></td>"
+           << "<td style=\"text-align: right; padding: 2px 8px;\">" << it->second.entries.size() << "</td></tr>";
+    }
+    os << "</table>";
+    os << "</div>";
+}
+
+// Numbers of failures of all libraries by reason with links to the pages
+// and to the pivot pages if they were saved
+void output_index(std::vector<library_fail_info> const& failures,
+                  std::vector<pivot_index> const& pivots,
+                  std::ostream & os,
+                  options const& op)
+{
+    std::size_t reasons_count = classification_rules().size();
+
+    // cells of all libraries are counted in one pass
+    std::vector<std::size_t> counts(failures.size() * reasons_count, 0);
+    std::vector<std::size_t> totals(reasons_count, 0);
+    for ( std::size_t i = 0 ; i < failures.size() ; ++i )
+    {
+        BOOST_FOREACH(cell_info const& cell, failures[i].cells)
+        {
+            std::size_t r = cell.displayed_reason().index();
+            if ( r < reasons_count )
+            {
+                ++counts[i * reasons_count + r];
+                ++totals[r];
+            }
+        }
+    }
+
+    // only reasons of some failures are shown, the most important first
+    std::vector<reason_type> reasons;
+    for ( std::size_t r = 0 ; r < reasons_count ; ++r )
+    {
+        if ( totals[r] > 0 )
+            reasons.push_back(reason_type::from_index(r));
+    }
+    std::stable_sort(reasons.begin(), reasons.end(), is_more_important());
+
+    os << "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.0 Transitional//EN\""
+       << " \"http://www.w3.org/TR/xhtml1/DTD/xhtml1-transitional.dtd\">"
+       << "<html xmlns=\"http://www.w3.org/1999/xhtml\">"
+       << "<head><title>" << op.branch << " failures</title>"
+       << "<meta http-equiv=\"Content-Type\" content=\"text/html; charset=utf-8\"/>"
+       << "</head><body>";
+
+    os << "<h2>" << op.branch << " failures</h2>";
+    os << "<div style=\"margin:10px;\">";
+    os << "<table style=\"border-collapse: collapse;\">";
+
+    os << "<tr><th style=\"text-align: left; padding: 2px 8px;\">library</th>";
+    BOOST_FOREACH(reason_type reason, reasons)
+        os << "<th style=\"padding: 2px 8px; " << reason_to_style(reason) << "\">" << reason_label(reason) << "</th>";
+    os << "<th style=\"padding: 2px 8px;\">total</th></tr>";
+
+    for ( std::size_t i = 0 ; i < failures.size() && i < op.libraries.size() ; ++i )
+    {
+        std::string const& lib = op.libraries[i];
+        os << "<tr><td style=\"padding: 2px 8px;\">";
+
+        // processing of the library failed
+        if ( failures[i].library.empty() )
+        {
+            os << lib << "</td><td colspan=\"" << reasons.size() + 1 << "\" style=\"padding: 2px 8px;\">"
+               << "processing failed</td></tr>";
+            continue;
+        }
+
+        os << "<a href=\"pages/" << op.branch << '-' << lib << ".html\">" << lib << "</a></td>";
+
+        std::size_t total = 0;
+        BOOST_FOREACH(reason_type reason, reasons)
+        {
+            std::size_t count = counts[i * reasons_count + reason.index()];
+            total += count;
+            if ( count > 0 )
+                os << "<td style=\"text-align: right; padding: 2px 8px; " << reason_to_style(reason) << "\">" << count << "</td>";
+            else
+                os << "<td></td>";
+        }
+        os << "<td style=\"text-align: right; padding: 2px 8px;\">" << total << "</td></tr>";
+    }
+
+    std::size_t total = 0;
+    os << "<tr><th style=\"text-align: left; padding: 2px 8px;\">total</th>";
+    BOOST_FOREACH(reason_type reason, reasons)
+    {
+        total += totals[reason.index()];
+        os << "<th style=\"text-align: right; padding: 2px 8px;\">" << totals[reason.index()] << "</th>";
+    }
+    os << "<th style=\"text-align: right; padding: 2px 8px;\">" << total << "</th></tr>";
+
+    os << "</table>";
+    os << "</div>";
+
+    BOOST_FOREACH(pivot_index const& index, pivots)
+        output_pivot_links(index, os);
+
+    os << "</body></html>";
+}
+
+std::string json_string(std::string const& str)
+{
+    std::string result;
+    result.reserve(str.size() + 2);
+    result += '"';
+    BOOST_FOREACH(char c, str)
+    {
+        switch ( c )
+        {
+        case '"': result += "\\\""; break;
+        case '\\': result += "\\\\"; break;
+        case '\n': result += "\\n"; break;
+        case '\r': result += "\\r"; break;
+        case '\t': result += "\\t"; break;
+        default:
+            if ( static_cast<unsigned char>(c) < 0x20 )
+            {
+                char code[8];
+                std::sprintf(code, "\\u%04x", static_cast<unsigned int>(c));
+                result += code;
+            }
+            else
+            {
+                result += c;
+            }
+        }
+    }
+    result += '"';
+    return result;
+}
+
+std::string csv_field(std::string const& str)
+{
+    if ( str.find_first_of(",\"\r\n") == std::string::npos )
+        return str;
+
+    std::string result;
+    result.reserve(str.size() + 2);
+    result += '"';
+    BOOST_FOREACH(char c, str)
+    {
+        if ( c == '"' )
+            result += '"';
+        result += c;
+    }
+    result += '"';
+    return result;
+}
+
+// Writes the export as a flat list of records, one record per line
+// JSON - an array of objects, missing reasons are null
+// CSV - a header followed by rows, missing reasons are empty
+class failures_exporter
+{
+public:
+    failures_exporter(file_writer & writer_, bool json_)
+        : writer(writer_), json(json_), first(true)
+    {
+        if ( json )
+            writer.write("[\n");
+        else
+            writer.write("set,library,test,runner,toolset,reason,nested_reason,previous_reason,url\n");
+    }
+
+    // set - cell, new, changed or disappeared
+    void record(std::string const& set,
+                std::string const& library,
+                fail_id const& id,
+                reason_type reason,
+                reason_type nested_reason,
+                reason_type previous_reason,
+                std::string const& url)
+    {
+        if ( json )
+        {
+            if ( !first )
+                writer.write(",\n");
+            writer.write("{\"set\":");
+            writer.write(json_string(set));
+            writer.write(",\"library\":");
+            writer.write(json_string(library));
+            writer.write(",\"test\":");
+            writer.write(json_string(id.test_name_str()));
+            writer.write(",\"runner\":");
+            writer.write(json_string(id.runner_str()));
+            writer.write(",\"toolset\":");
+            writer.write(json_string(id.toolset_str()));
+            writer.write(",\"reason\":");
+            write_reason(reason);
+            writer.write(",\"nested_reason\":");
+            write_reason(nested_reason);
+            writer.write(",\"previous_reason\":");
+            write_reason(previous_reason);
+            writer.write(",\"url\":");
+            writer.write(json_string(url));
+            writer.put('}');
+        }
+        else
+        {
+            writer.write(csv_field(set));
+            writer.put(',');
+            writer.write(csv_field(library));
+            writer.put(',');
+            writer.write(csv_field(id.test_name_str()));
+            writer.put(',');
+            writer.write(csv_field(id.runner_str()));
+            writer.put(',');
+            writer.write(csv_field(id.toolset_str()));
+            writer.put(',');
+            write_reason(reason);
+            writer.put(',');
+            write_reason(nested_reason);
+            writer.put(',');
+            write_reason(previous_reason);
+            writer.put(',');
+            writer.write(csv_field(url));
+            writer.put('\n');
+        }
+        first = false;
+    }
+
+    void finish()
+    {
+        if ( json )
+            writer.write(first ? "]\n" : "\n]\n");
+    }
+
+private:
+    void write_reason(reason_type reason)
+    {
+        if ( json )
+            writer.write(reason.empty() ? std::string("null") : json_string(reason_label(reason)));
+        else if ( !reason.empty() )
+            writer.write(csv_field(reason_label(reason)));
+    }
+
+    file_writer & writer;
+    bool json;
+    bool first;
+};
+
+void export_compared(failures_exporter & exporter,
+                     std::string const& set,
+                     std::vector<compared_fail_info> const& errors)
+{
+    BOOST_FOREACH(compared_fail_info const& error, errors)
+    {
+        reason_type previous_reason;
+        if ( error.previous_fail_it )
+            previous_reason = (*error.previous_fail_it)->second.reason;
+
+        // urls of the previous run aren't stored in the log
+        if ( error.fail_it )
+        {
+            exporter.record(set, error.library_it->library,
+                            (*error.fail_it)->first,
+                            (*error.fail_it)->second.reason,
+                            reason_type(),
+                            previous_reason,
+                            (*error.fail_it)->second.url);
+        }
+        else if ( error.previous_fail_it )
+        {
+            exporter.record(set, error.library_it->library,
+                            (*error.previous_fail_it)->first,
+                            reason_type(),
+                            reason_type(),
+                            previous_reason,
+                            std::string());
+        }
+    }
+}
+
+// Streams all classified cells and the compared failures to the file
+void export_failures(std::vector<library_fail_info> const& failures,
+                     std::vector<compared_fail_info> const& new_errors,
+                     std::vector<compared_fail_info> const& changed_errors,
+                     std::vector<compared_fail_info> const& no_longer_errors,
+                     file_writer & writer,
+                     options const& op)
+{
+    failures_exporter exporter(writer, op.export_format == options::json);
+
+    BOOST_FOREACH(library_fail_info const& library, failures)
+    {
+        BOOST_FOREACH(cell_info const& cell, library.cells)
+        {
+            exporter.record("cell", library.library, cell.id,
+                            cell.reason, cell.nested_reason, reason_type(),
+                            cell.url);
+        }
+    }
+
+    export_compared(exporter, "new", new_errors);
+    export_compared(exporter, "changed", changed_errors);
+    export_compared(exporter, "disappeared", no_longer_errors);
+
+    exporter.finish();
+}
+
+// defined by the benchmark including this file
+#ifndef SUMMARY_ENHANCER_NO_MAIN
+
 int main(int argc, char **argv)
 {
     options op;
@@ -1270,6 +2868,43 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    // load classification rules
+    try
+    {
+        if ( classification_rules().load(op.rules_path) )
+            std::cout << "Rules found." << std::endl;
+        else
+            std::cout << "Rules not found, using defaults." << std::endl;
+    }
+    catch (std::exception & e)
+    {
+        std::cerr << "Error loading rules: " << e.what() << std::endl;
+        return 1;
+    }
+
+    // load classifications of the previous runs
+    if ( op.cache_classifications )
+    {
+        // logs are classified differently if rules, scan windows or the
+        // normalization of signatures are changed
+        std::stringstream rules_ss;
+        rules_ss << classification_rules().patterns()
+                 << "scan-head = " << op.scan_head << "\n"
+                 << "scan-tail = " << op.scan_tail << "\n"
+                 << "signature-version = " << failure_signature_version << "\n";
+        boost::uint64_t rules_version = content_hash(rules_ss.str());
+        try
+        {
+            classifications().load(op.cache_path, rules_version);
+        }
+        catch (std::exception & e)
+        {
+            std::cerr << "Error loading classifications cache: " << e.what() << std::endl;
+            boost::system::error_code ec;
+            boost::filesystem::remove(op.cache_path, ec); // ignore error
+        }
+    }
+
     // prepare the environment
     try
     {
@@ -1321,47 +2956,105 @@ int main(int argc, char **argv)
     // prepare container for new failures
     std::vector<library_fail_info> failures(op.libraries.size());
 
-    // process all libraries
-    for ( std::vector<std::string>::iterator it = op.libraries.begin() ;
-          it != op.libraries.end() ; ++it )
+    // pages are compressed while the next libraries are processed
+    background_compressor compressor(op.gzip);
+
+    // the stylesheet of compact pages
+    if ( op.render == options::compact )
     {
         try
         {
-            std::string const& lib = *it;
-            std::string url = op.view_url + lib + "_.html";
+            save_generated(op.output_dir + "compact.css", compact_stylesheet(), compressor, op);
+        }
+        catch (std::exception & e)
+        {
+            std::cerr << "Error saving style: " << e.what() << std::endl;
+            return 1;
+        }
+    }
 
-            if ( op.verbose )
-                std::cout << "Downloading: " << lib << std::endl;
-            else
-                std::cout << "Processing: " << lib << std::endl;
+    // the script loading parts of split pages
+    if ( op.chunk_rows > 0 )
+    {
+        try
+        {
+            save_generated(op.output_dir + "chunks.js", page_chunks_script(), compressor, op);
+        }
+        catch (std::exception & e)
+        {
+            std::cerr << "Error saving script: " << e.what() << std::endl;
+            return 1;
+        }
+    }
 
-            // download the summary page
-            std::string body = get_document(url);
+    // process all libraries
+    libraries_processor processor(op, compressor);
+    processor.run(failures);
 
-            if ( op.verbose )
-                std::cout << "Processing: " << lib << std::endl;
+    // pages of toolsets and runners
+    std::vector<pivot_index> pivots;
+    if ( op.pivot_pages )
+    {
+        std::cout << "Saving pivot pages." << std::endl;
 
-            // process the summary page
-            std::string processed_body;
-            process_document(lib, body, processed_body,
-                             failures[std::distance(op.libraries.begin(), it)].failures,
-                             op);
+        pivots.push_back(pivot_index("toolset"));
+        pivots.push_back(pivot_index("runner"));
+        build_pivot_indexes(failures, pivots[0], pivots[1], op);
 
-            // set library name
-            failures[std::distance(op.libraries.begin(), it)].library = lib;
+        BOOST_FOREACH(pivot_index const& index, pivots)
+        {
+            try
+            {
+                boost::filesystem::create_directories(op.output_dir + index.kind + "s");
 
-            // save processed summary page
-            std::string of_name = op.output_dir + "pages/" + op.branch + '-' + lib + ".html";
-            std::ofstream of(of_name.c_str(), std::ios::trunc);
-            of << processed_body;
-            of.close();
+                for ( std::map<std::string, pivot_index::group>::const_iterator it = index.groups.begin() ;
+                      it != index.groups.end() ; ++it )
+                {
+                    std::string page;
+                    {
+                        boost::iostreams::stream<boost::iostreams::back_insert_device<std::string> > page_stream(page);
+                        output_pivot(index, it, failures, page_stream, op);
+                    }
+
+                    save_generated(op.output_dir + it->second.path, page, compressor, op);
+                }
+            }
+            catch (std::exception & e)
+            {
+                std::cerr << "Error saving " << index.kind << " pages: " << e.what() << std::endl;
+            }
+        }
+    }
+
+    // the index of all processed libraries
+    {
+        std::cout << "Saving index." << std::endl;
+
+        try
+        {
+            std::string index;
+            {
+                boost::iostreams::stream<boost::iostreams::back_insert_device<std::string> > index_stream(index);
+                output_index(failures, pivots, index_stream, op);
+            }
+
+            save_generated(op.output_dir + "index.html", index, compressor, op);
         }
         catch (std::exception & e)
         {
-            std::cerr << "Error: " << e.what() << std::endl;
+            std::cerr << "Error saving index: " << e.what() << std::endl;
+        }
+    }
 
-            failures[std::distance(op.libraries.begin(), it)].library.clear();
-            failures[std::distance(op.libraries.begin(), it)].failures.clear();
+    if ( op.cache_classifications )
+    {
+        try
+        {
+            classifications().save(op.cache_path);
+        }
+        catch (std::exception & e)
+        {
+            std::cerr << "Error saving classifications cache: " << e.what() << std::endl;
         }
     }
 
@@ -1409,23 +3102,56 @@ int main(int argc, char **argv)
     // new log should be saved only if the email was sent properly
     bool is_safe_to_save_log = true;
 
-    // reporting enabled
+    // reporting or export enabled
     // NOTE: if tracking is disabled all errors will be treated as new
-    if ( op.send_report || op.save_report )
+    if ( op.send_report || op.save_report || op.export_format != options::no_export )
     {
         std::vector<compared_fail_info> new_errors;
         std::vector<compared_fail_info> changed_errors;
         std::vector<compared_fail_info> no_longer_errors;
         compare_failures_logs(old_failures, failures, new_errors, changed_errors, no_longer_errors);
 
-        std::stringstream report_stream;
-        output_report(new_errors, changed_errors, no_longer_errors, report_stream);
+        if ( op.export_format != options::no_export )
+        {
+            std::cout << "Saving export." << std::endl;
+
+            try
+            {
+                std::string export_path = op.output_dir
+                    + ( op.export_format == options::json ? "export.json" : "export.csv" );
+
+                file_writer writer(temporary_path(export_path));
+                export_failures(failures, new_errors, changed_errors, no_longer_errors, writer, op);
+                writer.close();
+
+                replace_file_if_changed(export_path);
+            }
+            catch (std::exception & e)
+            {
+                std::cerr << "Error saving export: " << e.what() << std::endl;
+            }
+        }
+
+        // the report is generated once and both saved and sent from this buffer
+        std::string report;
+        if ( op.send_report || op.save_report )
+        {
+            boost::iostreams::stream<boost::iostreams::back_insert_device<std::string> > report_stream(report);
+            output_report(new_errors, changed_errors, no_longer_errors, report_stream);
+        }
 
         if ( op.save_report )
         {
             std::cout << "Saving report." << std::endl;
-            std::ofstream ofs(op.output_dir + "report.html", std::ios::trunc);
-            ofs << report_stream.str();
+
+            try
+            {
+                save_generated(op.output_dir + "report.html", report, compressor, op);
+            }
+            catch (std::exception & e)
+            {
+                std::cerr << "Error saving report: " << e.what() << std::endl;
+            }
         }
 
         if ( op.send_report && ( !op.track_changes || !new_errors.empty() || !changed_errors.empty() || !no_longer_errors.empty() ) )
@@ -1457,7 +3183,7 @@ int main(int argc, char **argv)
                             subject = "Errors detected!";
                     }
 
-                    mail::send(cfg, subject, report_stream.str(), true);
+                    mail::send(cfg, subject, report, true);
                 }
                 catch (std::exception & e)
                 {
@@ -1474,20 +3200,24 @@ int main(int argc, char **argv)
 
         try
         {
-            std::ofstream ofs(failures_log_path.c_str(), std::ios::trunc | std::ios::binary);
-            if ( !ofs.is_open() )
-                throw std::runtime_error("unable to open file");
-
-            if ( op.log_format == options::xml )
             {
-                boost::archive::xml_oarchive oa(ofs);
-                oa << boost::serialization::make_nvp("libraries", failures);
-            }
-            else
-            {
-                boost::archive::binary_oarchive oa(ofs);
-                oa << boost::serialization::make_nvp("libraries", failures);
+                std::ofstream ofs(temporary_path(failures_log_path).c_str(), std::ios::trunc | std::ios::binary);
+                if ( !ofs.is_open() )
+                    throw std::runtime_error("unable to open file");
+
+                if ( op.log_format == options::xml )
+                {
+                    boost::archive::xml_oarchive oa(ofs);
+                    oa << boost::serialization::make_nvp("libraries", failures);
+                }
+                else
+                {
+                    boost::archive::binary_oarchive oa(ofs);
+                    oa << boost::serialization::make_nvp("libraries", failures);
+                }
             }
+
+            replace_file_if_changed(failures_log_path);
         }
         catch (std::exception & e)
         {
@@ -1497,3 +3227,5 @@ int main(int argc, char **argv)
 
     return 0;
 }
+
+#endif // SUMMARY_ENHANCER_NO_MAIN
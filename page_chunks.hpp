@@ -0,0 +1,196 @@
+// Copyright 2014 Adam Wulkiewicz.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef PAGE_CHUNKS_HPP
+#define PAGE_CHUNKS_HPP
+
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "rapidxml/rapidxml.hpp"
+#include "rapidxml/rapidxml_print.hpp"
+
+// Rows of a table moved from the page to a separate file
+struct page_chunk
+{
+    std::string path; // relative to the page
+    std::string content;
+};
+
+// Loads the rows of <tbody class="chunk" data-src="..."> when it's scrolled
+// into view, the placeholder row links to the chunk if it can't be loaded
+inline char const* page_chunks_script()
+{
+    return
+        "(function() {\n"
+        "    var bodies = document.querySelectorAll('tbody.chunk');\n"
+        "    function load(body) {\n"
+        "        if ( body.getAttribute('data-loaded') ) return;\n"
+        "        body.setAttribute('data-loaded', '1');\n"
+        "        var request = new XMLHttpRequest();\n"
+        "        request.open('GET', body.getAttribute('data-src'));\n"
+        "        request.onload = function() {\n"
+        "            if ( request.status == 200 ) body.innerHTML = request.responseText;\n"
+        "        };\n"
+        "        request.send();\n"
+        "    }\n"
+        "    if ( window.IntersectionObserver ) {\n"
+        "        var observer = new IntersectionObserver(function(entries) {\n"
+        "            entries.forEach(function(e) {\n"
+        "                if ( e.isIntersecting ) { observer.unobserve(e.target); load(e.target); }\n"
+        "            });\n"
+        "        }, { rootMargin: '1000px' });\n"
+        "        for ( var i = 0 ; i < bodies.length ; ++i ) observer.observe(bodies[i]);\n"
+        "    } else {\n"
+        "        for ( var i = 0 ; i < bodies.length ; ++i ) load(bodies[i]);\n"
+        "    }\n"
+        "})();\n";
+}
+
+namespace page_chunks_detail {
+
+// The text of the first link in the first cell of the row
+inline std::string row_label(rapidxml::xml_node<> const* row)
+{
+    rapidxml::xml_node<> const* td = row->first_node("td");
+    rapidxml::xml_node<> const* a = td ? td->first_node("a") : NULL;
+    std::string result = a ? std::string(a->value(), a->value_size()) : std::string();
+    boost::trim(result);
+    return result;
+}
+
+inline std::size_t cells_count(rapidxml::xml_node<> const* row)
+{
+    std::size_t result = 0;
+    for ( rapidxml::xml_node<> const* td = row->first_node("td") ; td ; td = td->next_sibling("td") )
+    {
+        rapidxml::xml_attribute<> const* colspan = td->first_attribute("colspan");
+        std::size_t span = 1;
+        if ( colspan )
+        {
+            try { span = boost::lexical_cast<std::size_t>(std::string(colspan->value(), colspan->value_size())); }
+            catch (boost::bad_lexical_cast const&) {}
+        }
+        result += (std::max)(span, std::size_t(1));
+    }
+    return result;
+}
+
+inline bool has_elements(rapidxml::xml_node<> const* n)
+{
+    for ( rapidxml::xml_node<> const* c = n->first_node() ; c ; c = c->next_sibling() )
+    {
+        if ( c->type() == rapidxml::node_element )
+            return true;
+    }
+    return false;
+}
+
+} // namespace page_chunks_detail
+
+// Moves the rows of the document to chunks of at most rows_per_chunk
+// consecutive rows of the same <tbody>. Each chunk is replaced with its own
+// <tbody> containing a placeholder row and the script loading the chunks is
+// added at the end of <body>.
+// The document must be modifiable, i.e. its pool must be active.
+// rows - <tr> elements in document order
+// directory - the directory of chunks relative to the page
+// script_path - the path of the file containing page_chunks_script()
+inline void split_into_chunks(rapidxml::xml_document<> & doc,
+                              std::vector<rapidxml::xml_node<> *> const& rows,
+                              std::string const& directory,
+                              std::size_t rows_per_chunk,
+                              std::string const& script_path,
+                              std::vector<page_chunk> & chunks)
+{
+    namespace detail = page_chunks_detail;
+
+    if ( rows.empty() || rows_per_chunk == 0 )
+        return;
+
+    std::set<rapidxml::xml_node<> *> tbodies;
+
+    std::size_t first = 0;
+    while ( first < rows.size() )
+    {
+        rapidxml::xml_node<> * tbody = rows[first]->parent();
+        rapidxml::xml_node<> * table = tbody ? tbody->parent() : NULL;
+        if ( table == NULL )
+        {
+            ++first;
+            continue;
+        }
+
+        std::size_t last = first + 1;
+        while ( last < rows.size() && last - first < rows_per_chunk && rows[last]->parent() == tbody )
+            ++last;
+
+        chunks.push_back(page_chunk());
+        page_chunk & chunk = chunks.back();
+        chunk.path = directory + '/' + boost::lexical_cast<std::string>(chunks.size()) + ".html";
+
+        std::back_insert_iterator<std::string> out(chunk.content);
+        for ( std::size_t i = first ; i < last ; ++i )
+            rapidxml::print(out, *rows[i], rapidxml::print_no_indenting);
+
+        // placeholder
+        std::string label = detail::row_label(rows[first]);
+        if ( last - first > 1 )
+            label += " - " + detail::row_label(rows[last - 1]);
+
+        rapidxml::xml_node<> * a = doc.allocate_node(rapidxml::node_element, "a", doc.allocate_string(label.c_str()));
+        a->append_attribute(doc.allocate_attribute("href", doc.allocate_string(chunk.path.c_str())));
+
+        std::string colspan = boost::lexical_cast<std::string>(detail::cells_count(rows[first]));
+        rapidxml::xml_node<> * td = doc.allocate_node(rapidxml::node_element, "td");
+        td->append_attribute(doc.allocate_attribute("colspan", doc.allocate_string(colspan.c_str())));
+        td->append_node(a);
+
+        rapidxml::xml_node<> * tr = doc.allocate_node(rapidxml::node_element, "tr");
+        tr->append_node(td);
+
+        rapidxml::xml_node<> * chunk_tbody = doc.allocate_node(rapidxml::node_element, "tbody");
+        chunk_tbody->append_attribute(doc.allocate_attribute("class", "chunk"));
+        chunk_tbody->append_attribute(doc.allocate_attribute("data-src", doc.allocate_string(chunk.path.c_str())));
+        chunk_tbody->append_node(tr);
+
+        table->insert_node(tbody, chunk_tbody);
+        for ( std::size_t i = first ; i < last ; ++i )
+            tbody->remove_node(rows[i]);
+        tbodies.insert(tbody);
+
+        first = last;
+    }
+
+    // original bodies containing only whitespace
+    for ( std::set<rapidxml::xml_node<> *>::iterator it = tbodies.begin() ; it != tbodies.end() ; ++it )
+    {
+        if ( !detail::has_elements(*it) )
+            (*it)->parent()->remove_node(*it);
+    }
+
+    // the element has a value so it's not printed as self-closing
+    rapidxml::xml_node<> * html = doc.first_node("html");
+    rapidxml::xml_node<> * body = html ? html->first_node("body") : NULL;
+    if ( body != NULL && !chunks.empty() )
+    {
+        rapidxml::xml_node<> * script = doc.allocate_node(rapidxml::node_element, "script", " ");
+        script->append_attribute(doc.allocate_attribute("type", "text/javascript"));
+        script->append_attribute(doc.allocate_attribute("src", doc.allocate_string(script_path.c_str())));
+        body->append_node(script);
+    }
+}
+
+#endif // PAGE_CHUNKS_HPP
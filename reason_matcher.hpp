@@ -0,0 +1,423 @@
+// Copyright 2014 Adam Wulkiewicz.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef REASON_MATCHER_HPP
+#define REASON_MATCHER_HPP
+
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#define REASON_MATCHER_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// Matches a set of rules against a log in one pass
+// A rule matches if any of its patterns is found. A pattern is either
+// a literal or a sequence of two literals found in the same line and separated
+// by at least one character, like regex "(first).+(second)" with "." not
+// matching line separators. All literals are compiled into one Aho-Corasick
+// automaton. Rules are prioritized, the rule with the lowest index wins.
+// With SSE2 parts of the log which can't contain any literal are skipped.
+// 16 positions are checked at once, a literal may start at a position if its
+// first and last characters are found at the right distance. The automaton
+// is run only from these positions.
+class reason_matcher
+{
+public:
+    static const std::size_t npos = std::size_t(-1);
+
+    // positions of at most this number of sequences are kept on the stack,
+    // otherwise they're allocated in each call of find()
+    static const std::size_t max_stack_sequences = 16;
+
+    reason_matcher()
+        : max_keyword_size(1)
+    {}
+
+    void add_literal(std::size_t rule, std::string const& literal)
+    {
+        add_action(add_keyword(literal), action(rule, literal_role, 0));
+    }
+
+    void add_sequence(std::size_t rule, std::string const& first, std::string const& second)
+    {
+        std::size_t sequence = sequences_firsts_sizes.size();
+        sequences_firsts_sizes.push_back(first.size());
+        add_action(add_keyword(first), action(rule, first_role, sequence));
+        add_action(add_keyword(second), action(rule, second_role, sequence));
+    }
+
+    // Builds the automaton, must be called after all patterns are added
+    void compile()
+    {
+        build_trie();
+        build_transitions();
+        build_prefilter();
+    }
+
+    // Returns the index of the matched rule with the highest priority or npos
+    std::size_t find(char const* first, char const* last) const
+    {
+        std::size_t best = npos;
+
+        // per sequence, the position of the first literal found in the current line
+        std::size_t stack_positions[max_stack_sequences];
+        std::vector<std::size_t> heap_positions;
+        std::size_t * sequences_positions = stack_positions;
+        if ( sequences_firsts_sizes.size() > max_stack_sequences )
+        {
+            heap_positions.resize(sequences_firsts_sizes.size());
+            sequences_positions = &heap_positions[0];
+        }
+        std::fill(sequences_positions, sequences_positions + sequences_firsts_sizes.size(), npos);
+        // position after the last line separator
+        std::size_t line_begin = 0;
+
+        std::size_t size = last - first;
+        unsigned state = 0;
+        for ( std::size_t i = 0 ; i < size ; ++i )
+        {
+#ifdef REASON_MATCHER_SSE2
+            // no literal is being matched, go to the next possible beginning of a literal
+            if ( state == 0 )
+            {
+                i = skip(first, size, i, line_begin);
+                if ( i >= size )
+                    break;
+            }
+#endif
+
+            unsigned char c = static_cast<unsigned char>(first[i]);
+            if ( is_separator(c) )
+                line_begin = i + 1;
+
+            state = transitions[state * 256 + c];
+
+            for ( unsigned o = outputs_offsets[state] ; o < outputs_offsets[state + 1] ; ++o )
+            {
+                keyword const& k = keywords[outputs[o]];
+                std::size_t position = i + 1 - k.size;
+
+                for ( std::size_t a = k.actions_begin ; a < k.actions_end ; ++a )
+                {
+                    action const& act = actions[a];
+                    if ( act.rule >= best )
+                        continue;
+
+                    if ( act.role == literal_role )
+                    {
+                        best = act.rule;
+                    }
+                    else if ( act.role == first_role )
+                    {
+                        std::size_t & p = sequences_positions[act.sequence];
+                        if ( p == npos || p < line_begin )
+                            p = position;
+                    }
+                    else // second_role
+                    {
+                        std::size_t p = sequences_positions[act.sequence];
+                        if ( p != npos && p >= line_begin
+                          && position > p + sequences_firsts_sizes[act.sequence] )
+                        {
+                            best = act.rule;
+                        }
+                    }
+                }
+            }
+
+            // nothing better can be found
+            if ( best == 0 )
+                break;
+        }
+
+        return best;
+    }
+
+    std::size_t find(std::string const& str) const
+    {
+        return find(str.data(), str.data() + str.size());
+    }
+
+private:
+    static bool is_separator(unsigned char c)
+    {
+        return c == '\n' || c == '\r' || c == '\f';
+    }
+
+#ifdef REASON_MATCHER_SSE2
+    static unsigned lowest_bit(unsigned mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return index;
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    static unsigned highest_bit(unsigned mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse(&index, mask);
+        return index;
+#else
+        return 31 - __builtin_clz(mask);
+#endif
+    }
+
+    // Returns the first position not lower than i where a literal may start
+    // or the position from which the rest of the log must be checked one by one.
+    // line_begin is updated with separators found before the returned position.
+    std::size_t skip(char const* data, std::size_t size, std::size_t i, std::size_t & line_begin) const
+    {
+        __m128i const newline = _mm_set1_epi8('\n');
+        __m128i const carriage_return = _mm_set1_epi8('\r');
+        __m128i const form_feed = _mm_set1_epi8('\f');
+
+        for ( ; i + max_keyword_size - 1 + 16 <= size ; i += 16 )
+        {
+            __m128i const block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+
+            __m128i candidates = _mm_setzero_si128();
+            for ( std::size_t g = 0 ; g < prefilter_groups.size() ; ++g )
+            {
+                prefilter_group const& group = prefilter_groups[g];
+                __m128i const block_last = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i + group.last_offset));
+                for ( std::size_t b = group.bytes_begin ; b < group.bytes_end ; b += 2 )
+                {
+                    __m128i const eq_first = _mm_cmpeq_epi8(block, _mm_set1_epi8(prefilter_bytes[b]));
+                    __m128i const eq_last = _mm_cmpeq_epi8(block_last, _mm_set1_epi8(prefilter_bytes[b + 1]));
+                    candidates = _mm_or_si128(candidates, _mm_and_si128(eq_first, eq_last));
+                }
+            }
+
+            unsigned separators = _mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(block, newline),
+                    _mm_or_si128(_mm_cmpeq_epi8(block, carriage_return),
+                                 _mm_cmpeq_epi8(block, form_feed))));
+            unsigned candidates_mask = _mm_movemask_epi8(candidates);
+
+            if ( candidates_mask != 0 )
+            {
+                unsigned first_candidate = lowest_bit(candidates_mask);
+                separators &= (1u << first_candidate) - 1;
+                if ( separators != 0 )
+                    line_begin = i + highest_bit(separators) + 1;
+                return i + first_candidate;
+            }
+
+            if ( separators != 0 )
+                line_begin = i + highest_bit(separators) + 1;
+        }
+
+        return i;
+    }
+#endif
+
+    enum role_type { literal_role, first_role, second_role };
+
+    struct action
+    {
+        action(std::size_t rule_, role_type role_, std::size_t sequence_)
+            : rule(rule_), role(role_), sequence(sequence_)
+        {}
+
+        std::size_t rule;
+        role_type role;
+        std::size_t sequence;
+    };
+
+    struct keyword
+    {
+        keyword(std::string const& str_)
+            : str(str_), size(str_.size()), actions_begin(0), actions_end(0)
+        {}
+
+        std::string str;
+        std::size_t size;
+        std::size_t actions_begin;
+        std::size_t actions_end;
+        std::vector<action> pending_actions;
+    };
+
+    std::size_t add_keyword(std::string const& str)
+    {
+        if ( str.empty() )
+            throw std::runtime_error("empty pattern");
+
+        for ( std::size_t i = 0 ; i < keywords.size() ; ++i )
+            if ( keywords[i].str == str )
+                return i;
+        keywords.push_back(keyword(str));
+        return keywords.size() - 1;
+    }
+
+    void add_action(std::size_t k, action const& act)
+    {
+        keywords[k].pending_actions.push_back(act);
+    }
+
+    void build_trie()
+    {
+        // flatten actions
+        actions.clear();
+        for ( std::size_t k = 0 ; k < keywords.size() ; ++k )
+        {
+            keywords[k].actions_begin = actions.size();
+            actions.insert(actions.end(), keywords[k].pending_actions.begin(), keywords[k].pending_actions.end());
+            keywords[k].actions_end = actions.size();
+        }
+
+        // goto function, 0 means no transition (root is never a target)
+        trie.assign(1, std::vector<unsigned>(256, 0));
+        trie_outputs.assign(1, std::vector<unsigned>());
+        for ( std::size_t k = 0 ; k < keywords.size() ; ++k )
+        {
+            unsigned state = 0;
+            std::string const& str = keywords[k].str;
+            for ( std::size_t i = 0 ; i < str.size() ; ++i )
+            {
+                unsigned char c = static_cast<unsigned char>(str[i]);
+                if ( trie[state][c] == 0 )
+                {
+                    trie[state][c] = static_cast<unsigned>(trie.size());
+                    trie.push_back(std::vector<unsigned>(256, 0));
+                    trie_outputs.push_back(std::vector<unsigned>());
+                }
+                state = trie[state][c];
+            }
+            trie_outputs[state].push_back(static_cast<unsigned>(k));
+        }
+    }
+
+    void build_transitions()
+    {
+        std::size_t states = trie.size();
+        std::vector<unsigned> fail(states, 0);
+        transitions.assign(states * 256, 0);
+
+        // breadth first, fail links of shorter prefixes are known first
+        std::deque<unsigned> queue;
+        for ( unsigned c = 0 ; c < 256 ; ++c )
+        {
+            unsigned s = trie[0][c];
+            transitions[c] = s;
+            if ( s != 0 )
+                queue.push_back(s);
+        }
+
+        while ( !queue.empty() )
+        {
+            unsigned state = queue.front();
+            queue.pop_front();
+
+            // outputs of the longest proper suffix
+            std::vector<unsigned> const& fail_outputs = trie_outputs[fail[state]];
+            trie_outputs[state].insert(trie_outputs[state].end(), fail_outputs.begin(), fail_outputs.end());
+
+            for ( unsigned c = 0 ; c < 256 ; ++c )
+            {
+                unsigned s = trie[state][c];
+                if ( s != 0 )
+                {
+                    fail[s] = transitions[fail[state] * 256 + c];
+                    transitions[state * 256 + c] = s;
+                    queue.push_back(s);
+                }
+                else
+                {
+                    transitions[state * 256 + c] = transitions[fail[state] * 256 + c];
+                }
+            }
+        }
+
+        outputs.clear();
+        outputs_offsets.assign(1, 0);
+        for ( std::size_t s = 0 ; s < states ; ++s )
+        {
+            outputs.insert(outputs.end(), trie_outputs[s].begin(), trie_outputs[s].end());
+            outputs_offsets.push_back(static_cast<unsigned>(outputs.size()));
+        }
+
+        trie.clear();
+        trie_outputs.clear();
+    }
+
+    // first and last characters of literals, grouped by the distance between them
+    void build_prefilter()
+    {
+        std::vector<std::vector<std::pair<char, char> > > by_size;
+        max_keyword_size = 1;
+        for ( std::size_t k = 0 ; k < keywords.size() ; ++k )
+        {
+            std::string const& str = keywords[k].str;
+            if ( by_size.size() < str.size() )
+                by_size.resize(str.size());
+            std::pair<char, char> bytes(str[0], str[str.size() - 1]);
+            std::vector<std::pair<char, char> > & group = by_size[str.size() - 1];
+            if ( std::find(group.begin(), group.end(), bytes) == group.end() )
+                group.push_back(bytes);
+            if ( max_keyword_size < str.size() )
+                max_keyword_size = str.size();
+        }
+
+        prefilter_groups.clear();
+        prefilter_bytes.clear();
+        for ( std::size_t offset = 0 ; offset < by_size.size() ; ++offset )
+        {
+            if ( by_size[offset].empty() )
+                continue;
+
+            prefilter_group group;
+            group.last_offset = offset;
+            group.bytes_begin = prefilter_bytes.size();
+            for ( std::size_t b = 0 ; b < by_size[offset].size() ; ++b )
+            {
+                prefilter_bytes.push_back(by_size[offset][b].first);
+                prefilter_bytes.push_back(by_size[offset][b].second);
+            }
+            group.bytes_end = prefilter_bytes.size();
+            prefilter_groups.push_back(group);
+        }
+    }
+
+    struct prefilter_group
+    {
+        std::size_t last_offset;
+        std::size_t bytes_begin;
+        std::size_t bytes_end;
+    };
+
+    std::vector<keyword> keywords;
+    std::vector<action> actions;
+    std::vector<std::size_t> sequences_firsts_sizes;
+
+    std::vector<std::vector<unsigned> > trie;
+    std::vector<std::vector<unsigned> > trie_outputs;
+
+    std::vector<unsigned> transitions;
+    std::vector<unsigned> outputs_offsets;
+    std::vector<unsigned> outputs;
+
+    std::size_t max_keyword_size;
+    std::vector<prefilter_group> prefilter_groups;
+    std::vector<char> prefilter_bytes;
+};
+
+#endif // REASON_MATCHER_HPP
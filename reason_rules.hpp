@@ -0,0 +1,485 @@
+// Copyright 2014 Adam Wulkiewicz.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef REASON_RULES_HPP
+#define REASON_RULES_HPP
+
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "reason_matcher.hpp"
+
+// Compact identifier of a failure reason
+// Built-in reasons have fixed values, reasons defined only in the rules file
+// get the following values.
+class reason_type
+{
+public:
+    enum builtin { time, file, ierr, comp, link, run, unkn, builtin_count };
+
+    reason_type() : id(none_id) {}
+    reason_type(builtin b) : id(static_cast<unsigned char>(b)) {}
+
+    static reason_type from_index(std::size_t index)
+    {
+        if ( index >= none_id )
+            throw std::runtime_error("too many reasons");
+        reason_type r;
+        r.id = static_cast<unsigned char>(index);
+        return r;
+    }
+
+    std::size_t index() const { return id; }
+    bool empty() const { return id == none_id; }
+
+    bool operator==(reason_type const& r) const { return id == r.id; }
+    bool operator!=(reason_type const& r) const { return id != r.id; }
+
+private:
+    static const unsigned char none_id = 255;
+
+    unsigned char id;
+};
+
+struct builtin_reason_info
+{
+    char const* label;
+    int importance;
+    bool important;
+    char const* style;
+};
+
+// Indexed by reason_type::builtin
+constexpr builtin_reason_info builtin_reasons[reason_type::builtin_count] = {
+    { "time", 0, false, "background-color: #88ff00;" },
+    { "file", 1, false, "background-color: #00ff88;" },
+    { "ierr", 2, false, "background-color: #ff88ff;" },
+    { "comp", 6, true, "background-color: #ffbb00;" },
+    { "link", 5, true, "background-color: #ffdd00;" },
+    { "run", 4, true, "background-color: #ffff00;" },
+    { "unkn", 3, true, "background-color: #ffff88;" }
+};
+
+struct builtin_pattern
+{
+    reason_type::builtin reason;
+    char const* first;
+    char const* second; // NULL for literals
+};
+
+// In the order of checking
+constexpr builtin_pattern builtin_patterns[] = {
+    // time limit exceeded
+    { reason_type::time, "second time limit exceeded", NULL },
+    // File too big, /bigobj, No space left on device, etc.
+    { reason_type::file, "Fatal error: can't write", NULL },
+    { reason_type::file, "Fatal error: can't close", NULL },
+    { reason_type::file, "File too big", NULL },
+    { reason_type::file, "/bigobj", NULL },
+    { reason_type::file, "No matching files were found", NULL },
+    // internal compiler error
+    { reason_type::ierr, "internal compiler error", NULL },
+    { reason_type::ierr, "internal error", NULL },
+    // compilation failed
+    { reason_type::comp, "Compile", "fail" },
+    // linking failed
+    { reason_type::link, "Link", "fail" },
+    // run failed
+    { reason_type::run, "Run", "fail" }
+};
+
+constexpr std::size_t builtin_patterns_count = sizeof(builtin_patterns) / sizeof(builtin_patterns[0]);
+
+constexpr std::size_t builtin_sequences_count(std::size_t i = 0)
+{
+    return i < builtin_patterns_count
+         ? ( builtin_patterns[i].second != NULL ? 1 : 0 ) + builtin_sequences_count(i + 1)
+         : 0;
+}
+
+constexpr bool are_builtin_patterns_valid(std::size_t i = 0)
+{
+    return i >= builtin_patterns_count
+        || ( builtin_patterns[i].first != NULL && builtin_patterns[i].first[0] != '\0'
+          && ( builtin_patterns[i].second == NULL || builtin_patterns[i].second[0] != '\0' )
+          && builtin_patterns[i].reason != reason_type::unkn
+          && are_builtin_patterns_valid(i + 1) );
+}
+
+static_assert(are_builtin_patterns_valid(),
+              "built-in patterns must be non-empty and unkn must have no patterns");
+static_assert(builtin_sequences_count() <= reason_matcher::max_stack_sequences,
+              "built-in patterns must be matched without allocation");
+
+// Failure reason, the patterns found in the log and the way it is reported
+struct reason_rule
+{
+    reason_rule()
+        : importance(-1)
+        , important(false)
+    {}
+
+    explicit reason_rule(std::string const& label_)
+        : label(label_)
+        , importance(-1)
+        , important(false)
+    {}
+
+    std::string label;
+    int importance; // used to choose between reasons of nested logs
+    bool important; // saved in the failures log and reported
+    std::string style;
+
+    std::vector<std::string> literals;
+    std::vector<std::pair<std::string, std::string> > sequences; // first ... second in one line
+};
+
+// Classification rules, checked in the order of definition
+// The rule without patterns is the fallback used if nothing was found.
+//
+// Rules file format:
+//
+//   # comment
+//   [label]
+//   importance = 6
+//   important = true
+//   style = background-color: #ffbb00;
+//   literal = internal compiler error
+//   line = Compile ... fail
+//
+// literal and line may be used many times, line means that both parts must be
+// found in the same line and separated by at least one character.
+class reason_rules
+{
+public:
+    reason_rules()
+    {
+        set_default();
+    }
+
+    void set_default()
+    {
+        std::vector<reason_rule> r;
+
+        for ( std::size_t i = 0 ; i < reason_type::builtin_count ; ++i )
+        {
+            r.push_back(reason_rule(builtin_reasons[i].label));
+            r.back().importance = builtin_reasons[i].importance;
+            r.back().important = builtin_reasons[i].important;
+            r.back().style = builtin_reasons[i].style;
+        }
+
+        for ( std::size_t i = 0 ; i < builtin_patterns_count ; ++i )
+        {
+            builtin_pattern const& p = builtin_patterns[i];
+            if ( p.second == NULL )
+                r[p.reason].literals.push_back(p.first);
+            else
+                r[p.reason].sequences.push_back(std::make_pair(p.first, p.second));
+        }
+
+        set(r);
+    }
+    // Returns false if the file can't be opened, throws if it's invalid
+    bool load(std::string const& filename)
+    {
+        std::ifstream file(filename.c_str());
+        if ( !file.is_open() )
+            return false;
+
+        std::vector<reason_rule> r;
+        std::string line;
+        for ( int line_number = 1 ; std::getline(file, line) ; ++line_number )
+        {
+            boost::trim(line);
+            if ( line.empty() || line[0] == '#' )
+                continue;
+
+            if ( line[0] == '[' )
+            {
+                if ( line.size() < 3 || line[line.size() - 1] != ']' )
+                    throw_error(filename, line_number, "invalid section");
+                r.push_back(reason_rule());
+                r.back().label = boost::trim_copy(line.substr(1, line.size() - 2));
+                continue;
+            }
+
+            std::string::size_type eq = line.find('=');
+            if ( eq == std::string::npos )
+                throw_error(filename, line_number, "expected key = value");
+            if ( r.empty() )
+                throw_error(filename, line_number, "expected [label]");
+
+            std::string key = boost::trim_copy(line.substr(0, eq));
+            std::string val = boost::trim_copy(line.substr(eq + 1));
+            reason_rule & rule = r.back();
+
+            if ( key == "importance" )
+            {
+                try { rule.importance = boost::lexical_cast<int>(val); }
+                catch (boost::bad_lexical_cast &) { throw_error(filename, line_number, "invalid importance"); }
+            }
+            else if ( key == "important" )
+            {
+                if ( val != "true" && val != "false" )
+                    throw_error(filename, line_number, "expected true or false");
+                rule.important = val == "true";
+            }
+            else if ( key == "style" )
+            {
+                rule.style = val;
+            }
+            else if ( key == "literal" )
+            {
+                if ( val.empty() )
+                    throw_error(filename, line_number, "empty literal");
+                rule.literals.push_back(val);
+            }
+            else if ( key == "line" )
+            {
+                std::string::size_type dots = val.find(" ... ");
+                if ( dots == std::string::npos )
+                    throw_error(filename, line_number, "expected first ... second");
+                std::string first = boost::trim_copy(val.substr(0, dots));
+                std::string second = boost::trim_copy(val.substr(dots + 5));
+                if ( first.empty() || second.empty() )
+                    throw_error(filename, line_number, "empty line pattern");
+                rule.sequences.push_back(std::make_pair(first, second));
+            }
+            else
+            {
+                throw_error(filename, line_number, "unknown key " + key);
+            }
+        }
+
+        set(r);
+        return true;
+    }
+
+    reason_type find_reason(std::string const& log) const
+    {
+        std::size_t rule = matcher.find(log);
+        return rule != reason_matcher::npos ? matched_rules[rule] : fallback;
+    }
+
+    // Checks only the first head and the last tail bytes of the log, cut at
+    // line boundaries if possible. The whole log is checked only if nothing
+    // was found in these windows.
+    reason_type find_reason(std::string const& log, std::size_t head, std::size_t tail) const
+    {
+        if ( head + tail >= log.size() )
+            return find_reason(log);
+
+        char const* first = log.data();
+        char const* last = first + log.size();
+
+        char const* head_last = first + head;
+        for ( char const* it = head_last ; it != first ; --it )
+        {
+            if ( is_line_end(*(it - 1)) )
+            {
+                head_last = it;
+                break;
+            }
+        }
+
+        char const* tail_first = last - tail;
+        for ( char const* it = tail_first ; it != last ; ++it )
+        {
+            if ( is_line_end(*it) )
+            {
+                tail_first = it + 1;
+                break;
+            }
+        }
+
+        std::size_t rule = (std::min)(matcher.find(first, head_last),
+                                      matcher.find(tail_first, last));
+        if ( rule == reason_matcher::npos )
+            rule = matcher.find(first, last);
+
+        return rule != reason_matcher::npos ? matched_rules[rule] : fallback;
+    }
+
+    // The reason used if no pattern was found
+    reason_type fallback_reason() const
+    {
+        return fallback;
+    }
+
+    // Number of reasons, ids of reasons are lower
+    std::size_t size() const
+    {
+        return rules.size();
+    }
+
+    std::string const& label(reason_type r) const
+    {
+        return get(r).label;
+    }
+
+    std::string const& style(reason_type r) const
+    {
+        return get(r).style;
+    }
+
+    int importance(reason_type r) const
+    {
+        return get(r).importance;
+    }
+
+    bool is_important(reason_type r) const
+    {
+        return get(r).important;
+    }
+
+    // Returns empty reason if there is no reason with the label
+    reason_type find(std::string const& label) const
+    {
+        boost::unordered_map<std::string, reason_type>::const_iterator it = indexes.find(label);
+        return it != indexes.end() ? it->second : reason_type();
+    }
+
+    // Returns the reason with the label, reasons not defined by the rules
+    // (e.g. read from old failures logs) are added without patterns and style
+    reason_type find_or_add(std::string const& label)
+    {
+        reason_type r = find(label);
+        if ( !r.empty() )
+            return r;
+
+        r = reason_type::from_index(rules.size());
+        rules.push_back(reason_rule(label));
+        indexes.insert(std::make_pair(label, r));
+        return r;
+    }
+
+    // Patterns of all reasons in the order of checking, different for rules
+    // classifying logs differently
+    std::string const& patterns() const
+    {
+        return patterns_definition;
+    }
+
+private:
+    void set(std::vector<reason_rule> const& r)
+    {
+        // built-in reasons keep their ids even if not defined
+        std::deque<reason_rule> all;
+        boost::unordered_map<std::string, reason_type> labels;
+        for ( std::size_t i = 0 ; i < reason_type::builtin_count ; ++i )
+        {
+            all.push_back(reason_rule(builtin_reasons[i].label));
+            labels.insert(std::make_pair(all.back().label, reason_type::from_index(i)));
+        }
+
+        reason_type fallback_reason;
+        reason_matcher m;
+        std::vector<reason_type> matched;
+        std::set<std::string> defined;
+        std::string definition;
+
+        for ( std::size_t i = 0 ; i < r.size() ; ++i )
+        {
+            if ( !defined.insert(r[i].label).second )
+                throw std::runtime_error("duplicated reason " + r[i].label);
+
+            reason_type id;
+            boost::unordered_map<std::string, reason_type>::const_iterator it = labels.find(r[i].label);
+            if ( it != labels.end() )
+            {
+                id = it->second;
+            }
+            else
+            {
+                id = reason_type::from_index(all.size());
+                all.push_back(reason_rule());
+                labels.insert(std::make_pair(r[i].label, id));
+            }
+            all[id.index()] = r[i];
+
+            if ( r[i].literals.empty() && r[i].sequences.empty() )
+            {
+                if ( !fallback_reason.empty() )
+                    throw std::runtime_error("more than one reason without patterns");
+                fallback_reason = id;
+                continue;
+            }
+
+            // matcher rules are indexes of reasons with patterns in the order of checking
+            std::size_t matcher_rule = matched.size();
+            matched.push_back(id);
+
+            definition += "[" + r[i].label + "]\n";
+            for ( std::size_t j = 0 ; j < r[i].literals.size() ; ++j )
+            {
+                m.add_literal(matcher_rule, r[i].literals[j]);
+                definition += "literal = " + r[i].literals[j] + "\n";
+            }
+            for ( std::size_t j = 0 ; j < r[i].sequences.size() ; ++j )
+            {
+                m.add_sequence(matcher_rule, r[i].sequences[j].first, r[i].sequences[j].second);
+                definition += "line = " + r[i].sequences[j].first + " ... " + r[i].sequences[j].second + "\n";
+            }
+        }
+
+        if ( fallback_reason.empty() )
+            throw std::runtime_error("missing reason without patterns");
+        definition += "[" + all[fallback_reason.index()].label + "]\n";
+
+        m.compile();
+
+        rules.swap(all);
+        fallback = fallback_reason;
+        indexes.swap(labels);
+        matcher = m;
+        matched_rules.swap(matched);
+        patterns_definition.swap(definition);
+    }
+
+    reason_rule const& get(reason_type r) const
+    {
+        static const reason_rule none;
+        return r.index() < rules.size() ? rules[r.index()] : none;
+    }
+
+    static bool is_line_end(char c)
+    {
+        return c == '\n' || c == '\r' || c == '\f';
+    }
+
+    static void throw_error(std::string const& filename, int line_number, std::string const& msg)
+    {
+        std::stringstream ss;
+        ss << filename << "(" << line_number << "): " << msg;
+        throw std::runtime_error(ss.str());
+    }
+
+    // indexed by reason_type, labels and styles are referenced by documents
+    // so they must not be moved when reasons are added
+    std::deque<reason_rule> rules;
+    reason_type fallback;
+    boost::unordered_map<std::string, reason_type> indexes;
+    reason_matcher matcher;
+    std::vector<reason_type> matched_rules;
+    std::string patterns_definition;
+};
+
+#endif // REASON_RULES_HPP
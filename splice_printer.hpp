@@ -0,0 +1,150 @@
+// Copyright 2014 Adam Wulkiewicz.
+
+// Use, modification and distribution is subject to the Boost Software License,
+// Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+
+#ifndef SPLICE_PRINTER_HPP
+#define SPLICE_PRINTER_HPP
+
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include "rapidxml/rapidxml.hpp"
+#include "rapidxml/rapidxml_print.hpp"
+
+#include "file_writer.hpp"
+
+// Prints the original page with modified elements spliced in
+// The page must be parsed in situ, names of elements point into the parsed
+// buffer so the position of each element in the original page is known.
+// Only the opening tags and optionally the text of the modified elements are
+// printed from the document, the rest is copied from the original page.
+class splice_printer
+    : boost::noncopyable
+{
+public:
+    // parsed - the beginning of the buffer parsed in situ
+    // original - the copy of the buffer made before parsing
+    splice_printer(char const* parsed_, std::string const& original_)
+        : parsed(parsed_)
+        , original(original_)
+    {}
+
+    // Replaces the opening tag of the element and its text if content is true,
+    // must be called once per element
+    void add(rapidxml::xml_node<> const* element, bool content)
+    {
+        if ( element->name() < parsed + 1 )
+            throw std::runtime_error("element not found in the original page");
+        std::size_t begin = element->name() - parsed - 1;
+        if ( begin >= original.size() || original[begin] != '<' )
+            throw std::runtime_error("element not found in the original page");
+
+        std::size_t tag_end = find_tag_end(begin);
+        bool self_closing = original[tag_end - 2] == '/';
+
+        patches.push_back(patch(begin, tag_end));
+        std::back_insert_iterator<std::string> out(patches.back().replacement);
+
+        if ( content && self_closing )
+        {
+            rapidxml::print(out, *element, rapidxml::print_no_indenting);
+            return;
+        }
+
+        *out = '<';
+        out = std::copy(element->name(), element->name() + element->name_size(), out);
+        out = rapidxml::internal::print_attributes(out, element, 0);
+        if ( self_closing )
+            *out = '/';
+        *out = '>';
+
+        if ( content && !self_closing )
+        {
+            std::size_t text_end = original.find('<', tag_end);
+            if ( text_end == std::string::npos )
+                text_end = original.size();
+
+            patches.push_back(patch(tag_end, text_end));
+            std::back_insert_iterator<std::string> text_out(patches.back().replacement);
+
+            rapidxml::xml_node<> const* child = element->first_node();
+            if ( child != NULL && child->type() == rapidxml::node_data )
+                rapidxml::internal::copy_and_expand_chars(child->value(), child->value() + child->value_size(), char(0), text_out);
+            else if ( child == NULL )
+                rapidxml::internal::copy_and_expand_chars(element->value(), element->value() + element->value_size(), char(0), text_out);
+        }
+    }
+
+    void print(file_writer & writer)
+    {
+        std::sort(patches.begin(), patches.end());
+
+        std::size_t pos = 0;
+        for ( std::vector<patch>::const_iterator it = patches.begin() ; it != patches.end() ; ++it )
+        {
+            if ( it->begin < pos )
+                throw std::runtime_error("overlapping elements");
+            writer.write(original.data() + pos, it->begin - pos);
+            writer.write(it->replacement);
+            pos = it->end;
+        }
+        writer.write(original.data() + pos, original.size() - pos);
+    }
+
+private:
+    struct patch
+    {
+        patch(std::size_t begin_, std::size_t end_)
+            : begin(begin_), end(end_)
+        {}
+
+        bool operator<(patch const& p) const
+        {
+            return begin < p.begin;
+        }
+
+        std::size_t begin;
+        std::size_t end;
+        std::string replacement;
+    };
+
+    // Returns the position after '>' closing the tag starting at begin
+    std::size_t find_tag_end(std::size_t begin) const
+    {
+        char quote = 0;
+        for ( std::size_t i = begin + 1 ; i < original.size() ; ++i )
+        {
+            char c = original[i];
+            if ( quote != 0 )
+            {
+                if ( c == quote )
+                    quote = 0;
+            }
+            else if ( c == '"' || c == '\'' )
+            {
+                quote = c;
+            }
+            else if ( c == '>' )
+            {
+                return i + 1;
+            }
+        }
+        throw std::runtime_error("unterminated tag in the original page");
+    }
+
+    char const* parsed;
+    std::string const& original;
+    std::vector<patch> patches;
+};
+
+#endif // SPLICE_PRINTER_HPP